@@ -27,7 +27,9 @@
 import numpy as np
 import sys
 import json
+import torch
 from torch import nn
+from torch.utils.dlpack import from_dlpack
 
 # triton_python_backend_utils is available in every Triton Python model. You
 # need to use this module to create inference requests and responses. It also
@@ -35,6 +37,19 @@ from torch import nn
 # and converting Triton input/output types to numpy types.
 import triton_python_backend_utils as pb_utils
 
+# PyTorch types of the Triton types that PyTorch supports
+TRITON_STRING_TO_TORCH = {
+    'TYPE_BOOL': torch.bool,
+    'TYPE_UINT8': torch.uint8,
+    'TYPE_INT8': torch.int8,
+    'TYPE_INT16': torch.int16,
+    'TYPE_INT32': torch.int32,
+    'TYPE_INT64': torch.int64,
+    'TYPE_FP16': torch.float16,
+    'TYPE_FP32': torch.float32,
+    'TYPE_FP64': torch.float64
+}
+
 
 class AddSubNet(nn.Module):
     """
@@ -84,11 +99,11 @@ class TritonPythonModel:
         output1_config = pb_utils.get_output_config_by_name(
             model_config, "OUTPUT1")
 
-        # Convert Triton types to numpy types
-        self.output0_dtype = pb_utils.triton_string_to_numpy(
-            output0_config['data_type'])
-        self.output1_dtype = pb_utils.triton_string_to_numpy(
-            output1_config['data_type'])
+        # Convert Triton types to PyTorch types
+        self.output0_dtype = TRITON_STRING_TO_TORCH[
+            output0_config['data_type']]
+        self.output1_dtype = TRITON_STRING_TO_TORCH[
+            output1_config['data_type']]
 
         # Instantiate the PyTorch model
         self.add_sub_model = AddSubNet()
@@ -128,14 +143,19 @@ class TritonPythonModel:
             # Get INPUT1
             in_1 = pb_utils.get_input_tensor_by_name(request, "INPUT1")
 
-            out_0, out_1 = self.add_sub_model(in_0.as_numpy(), in_1.as_numpy())
+            # The inputs are used by PyTorch through DLPack, without copying
+            # them out of the shared memory.
+            out_0, out_1 = self.add_sub_model(from_dlpack(in_0.to_dlpack()),
+                                              from_dlpack(in_1.to_dlpack()))
 
             # Create output tensors. You need pb_utils.Tensor
-            # objects to create pb_utils.InferenceResponse.
-            out_tensor_0 = pb_utils.Tensor("OUTPUT0",
-                                           out_0.astype(output0_dtype))
-            out_tensor_1 = pb_utils.Tensor("OUTPUT1",
-                                           out_1.astype(output1_dtype))
+            # objects to create pb_utils.InferenceResponse. PyTorch tensors
+            # are copied to the shared memory without converting them to
+            # numpy arrays.
+            out_tensor_0 = pb_utils.Tensor.from_dlpack(
+                "OUTPUT0", out_0.to(output0_dtype))
+            out_tensor_1 = pb_utils.Tensor.from_dlpack(
+                "OUTPUT1", out_1.to(output1_dtype))
 
             # Create InferenceResponse. You can set an error here in case
             # there was a problem with handling this inference request.
@@ -0,0 +1,337 @@
+// Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pb_convert.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PB_CONVERT_X86
+#endif
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+//
+// Scalar FP16 conversions, used when F16C is not available and for the tail
+// of the vectorized loops.
+//
+float
+HalfToFloat(uint16_t h)
+{
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t bits;
+
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Subnormal half, normalize it.
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      mantissa &= 0x3ff;
+      bits = sign | (exponent << 23) | (mantissa << 13);
+    }
+  } else if (exponent == 0x1f) {
+    // Inf or NaN
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+uint16_t
+FloatToHalf(float f)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t abs_bits = bits & 0x7fffffff;
+
+  // Inf or NaN
+  if (abs_bits >= 0x7f800000) {
+    return sign | 0x7c00 | ((abs_bits > 0x7f800000) ? 0x200 : 0);
+  }
+
+  // Overflow to Inf
+  if (abs_bits >= 0x477ff000) {
+    return sign | 0x7c00;
+  }
+
+  // Subnormal half or zero
+  if (abs_bits < 0x38800000) {
+    if (abs_bits < 0x33000000) {
+      return sign;
+    }
+    uint32_t exponent = abs_bits >> 23;
+    uint32_t mantissa = (abs_bits & 0x7fffff) | 0x800000;
+    uint32_t shift = 126 - exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if ((remainder > halfway) ||
+        ((remainder == halfway) && (half_mantissa & 1))) {
+      half_mantissa++;
+    }
+    return sign | half_mantissa;
+  }
+
+  // Normal half, round to nearest even
+  uint32_t half_bits = (abs_bits - 0x38000000) >> 13;
+  uint32_t remainder = abs_bits & 0x1fff;
+  if ((remainder > 0x1000) || ((remainder == 0x1000) && (half_bits & 1))) {
+    half_bits++;
+  }
+  return sign | half_bits;
+}
+
+void
+HalfToFloatScalar(const uint16_t* src, float* dst, size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = HalfToFloat(src[i]);
+  }
+}
+
+void
+FloatToHalfScalar(const float* src, uint16_t* dst, size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = FloatToHalf(src[i]);
+  }
+}
+
+#ifdef PB_CONVERT_X86
+__attribute__((target("avx,f16c"))) void
+HalfToFloatF16C(const uint16_t* src, float* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  HalfToFloatScalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx,f16c"))) void
+FloatToHalfF16C(const float* src, uint16_t* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 f = _mm256_loadu_ps(src + i);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+  }
+  FloatToHalfScalar(src + i, dst + i, count - i);
+}
+
+bool
+HasF16C()
+{
+  static const bool has_f16c =
+      __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has_f16c;
+}
+#endif  // PB_CONVERT_X86
+
+void
+HalfToFloatBuffer(const uint16_t* src, float* dst, size_t count)
+{
+#ifdef PB_CONVERT_X86
+  if (HasF16C()) {
+    HalfToFloatF16C(src, dst, count);
+    return;
+  }
+#endif  // PB_CONVERT_X86
+  HalfToFloatScalar(src, dst, count);
+}
+
+void
+FloatToHalfBuffer(const float* src, uint16_t* dst, size_t count)
+{
+#ifdef PB_CONVERT_X86
+  if (HasF16C()) {
+    FloatToHalfF16C(src, dst, count);
+    return;
+  }
+#endif  // PB_CONVERT_X86
+  FloatToHalfScalar(src, dst, count);
+}
+
+// Element-wise static_cast. These simple loops are vectorized by the
+// compiler.
+template <typename SrcType, typename DstType>
+void
+CastBuffer(const void* src, void* dst, size_t count)
+{
+  const SrcType* typed_src = static_cast<const SrcType*>(src);
+  DstType* typed_dst = static_cast<DstType*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    typed_dst[i] = static_cast<DstType>(typed_src[i]);
+  }
+}
+
+template <typename SrcType>
+void
+WidenInteger(
+    const void* src, void* dst, TRITONSERVER_DataType dst_dtype, size_t count)
+{
+  switch (dst_dtype) {
+    case TRITONSERVER_TYPE_UINT16:
+      CastBuffer<SrcType, uint16_t>(src, dst, count);
+      break;
+    case TRITONSERVER_TYPE_UINT32:
+      CastBuffer<SrcType, uint32_t>(src, dst, count);
+      break;
+    case TRITONSERVER_TYPE_UINT64:
+      CastBuffer<SrcType, uint64_t>(src, dst, count);
+      break;
+    case TRITONSERVER_TYPE_INT16:
+      CastBuffer<SrcType, int16_t>(src, dst, count);
+      break;
+    case TRITONSERVER_TYPE_INT32:
+      CastBuffer<SrcType, int32_t>(src, dst, count);
+      break;
+    case TRITONSERVER_TYPE_INT64:
+      CastBuffer<SrcType, int64_t>(src, dst, count);
+      break;
+    default:
+      break;
+  }
+}
+
+bool
+IsSignedInteger(TRITONSERVER_DataType dtype)
+{
+  return (dtype == TRITONSERVER_TYPE_INT8) ||
+         (dtype == TRITONSERVER_TYPE_INT16) ||
+         (dtype == TRITONSERVER_TYPE_INT32) ||
+         (dtype == TRITONSERVER_TYPE_INT64);
+}
+
+bool
+IsUnsignedInteger(TRITONSERVER_DataType dtype)
+{
+  return (dtype == TRITONSERVER_TYPE_UINT8) ||
+         (dtype == TRITONSERVER_TYPE_UINT16) ||
+         (dtype == TRITONSERVER_TYPE_UINT32) ||
+         (dtype == TRITONSERVER_TYPE_UINT64);
+}
+
+}  // namespace
+
+bool
+IsDtypeConversionSupported(
+    TRITONSERVER_DataType src_dtype, TRITONSERVER_DataType dst_dtype)
+{
+  switch (src_dtype) {
+    case TRITONSERVER_TYPE_FP64:
+      return dst_dtype == TRITONSERVER_TYPE_FP32;
+    case TRITONSERVER_TYPE_FP32:
+      return (dst_dtype == TRITONSERVER_TYPE_FP64) ||
+             (dst_dtype == TRITONSERVER_TYPE_FP16);
+    case TRITONSERVER_TYPE_FP16:
+      return dst_dtype == TRITONSERVER_TYPE_FP32;
+    default:
+      break;
+  }
+
+  // Integer widening must preserve every value of the source type. Unsigned
+  // integers can also be widened to a larger signed integer.
+  const uint32_t src_size = TRITONSERVER_DataTypeByteSize(src_dtype);
+  const uint32_t dst_size = TRITONSERVER_DataTypeByteSize(dst_dtype);
+  if (IsSignedInteger(src_dtype)) {
+    return IsSignedInteger(dst_dtype) && (dst_size > src_size);
+  }
+  if (IsUnsignedInteger(src_dtype)) {
+    return (IsUnsignedInteger(dst_dtype) || IsSignedInteger(dst_dtype)) &&
+           (dst_size > src_size);
+  }
+
+  return false;
+}
+
+void
+ConvertBuffer(
+    const void* src, TRITONSERVER_DataType src_dtype, void* dst,
+    TRITONSERVER_DataType dst_dtype, size_t element_count)
+{
+  switch (src_dtype) {
+    case TRITONSERVER_TYPE_FP64:
+      CastBuffer<double, float>(src, dst, element_count);
+      break;
+    case TRITONSERVER_TYPE_FP32:
+      if (dst_dtype == TRITONSERVER_TYPE_FP64) {
+        CastBuffer<float, double>(src, dst, element_count);
+      } else {
+        FloatToHalfBuffer(
+            static_cast<const float*>(src), static_cast<uint16_t*>(dst),
+            element_count);
+      }
+      break;
+    case TRITONSERVER_TYPE_FP16:
+      HalfToFloatBuffer(
+          static_cast<const uint16_t*>(src), static_cast<float*>(dst),
+          element_count);
+      break;
+    case TRITONSERVER_TYPE_INT8:
+      WidenInteger<int8_t>(src, dst, dst_dtype, element_count);
+      break;
+    case TRITONSERVER_TYPE_INT16:
+      WidenInteger<int16_t>(src, dst, dst_dtype, element_count);
+      break;
+    case TRITONSERVER_TYPE_INT32:
+      WidenInteger<int32_t>(src, dst, dst_dtype, element_count);
+      break;
+    case TRITONSERVER_TYPE_UINT8:
+      WidenInteger<uint8_t>(src, dst, dst_dtype, element_count);
+      break;
+    case TRITONSERVER_TYPE_UINT16:
+      WidenInteger<uint16_t>(src, dst, dst_dtype, element_count);
+      break;
+    case TRITONSERVER_TYPE_UINT32:
+      WidenInteger<uint32_t>(src, dst, dst_dtype, element_count);
+      break;
+    default:
+      break;
+  }
+}
+
+}}}  // namespace triton::backend::python
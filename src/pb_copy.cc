@@ -0,0 +1,336 @@
+// Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pb_copy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+// Copies that are split across threads use chunks of at least this size, so
+// that each thread moves enough data to amortize the hand-off.
+constexpr size_t kMinChunkByteSize = 1024 * 1024;
+
+// Smaller copies are done with regular stores even if non-temporal stores are
+// requested, because the destination is likely to stay in the cache anyway.
+constexpr size_t kMinNonTemporalByteSize = 256 * 1024;
+
+// Number of elements per side of the tiles used to copy the two innermost
+// dimensions when neither of them is contiguous in the source.
+constexpr ssize_t kTileSize = 32;
+
+struct Dim {
+  ssize_t size;
+  ssize_t stride;
+};
+
+template <typename T>
+void
+CopyTile(
+    const char* src, ssize_t rows, ssize_t cols, ssize_t row_stride,
+    ssize_t col_stride, char* dst, ssize_t dst_row_stride)
+{
+  for (ssize_t i = 0; i < rows; i++) {
+    const char* src_row = src + i * row_stride;
+    T* dst_row = reinterpret_cast<T*>(dst + i * dst_row_stride);
+    for (ssize_t j = 0; j < cols; j++) {
+      T value;
+      std::memcpy(&value, src_row + j * col_stride, sizeof(T));
+      dst_row[j] = value;
+    }
+  }
+}
+
+void
+CopyTileAnySize(
+    const char* src, ssize_t rows, ssize_t cols, ssize_t row_stride,
+    ssize_t col_stride, char* dst, ssize_t dst_row_stride, size_t item_size)
+{
+  switch (item_size) {
+    case 1:
+      CopyTile<uint8_t>(
+          src, rows, cols, row_stride, col_stride, dst, dst_row_stride);
+      break;
+    case 2:
+      CopyTile<uint16_t>(
+          src, rows, cols, row_stride, col_stride, dst, dst_row_stride);
+      break;
+    case 4:
+      CopyTile<uint32_t>(
+          src, rows, cols, row_stride, col_stride, dst, dst_row_stride);
+      break;
+    case 8:
+      CopyTile<uint64_t>(
+          src, rows, cols, row_stride, col_stride, dst, dst_row_stride);
+      break;
+    default:
+      for (ssize_t i = 0; i < rows; i++) {
+        for (ssize_t j = 0; j < cols; j++) {
+          std::memcpy(
+              dst + i * dst_row_stride + j * item_size,
+              src + i * row_stride + j * col_stride, item_size);
+        }
+      }
+      break;
+  }
+}
+
+// Copy the two innermost dimensions. Rows are copied with memcpy when the
+// innermost dimension is contiguous, otherwise the copy is done in tiles so
+// that both the source and the destination stay in the cache.
+void
+CopyInner(
+    const char* src, const Dim& rows, const Dim& cols, char* dst,
+    size_t item_size)
+{
+  const ssize_t dst_row_stride = cols.size * item_size;
+  if (cols.stride == static_cast<ssize_t>(item_size)) {
+    for (ssize_t i = 0; i < rows.size; i++) {
+      std::memcpy(
+          dst + i * dst_row_stride, src + i * rows.stride, dst_row_stride);
+    }
+    return;
+  }
+
+  for (ssize_t i = 0; i < rows.size; i += kTileSize) {
+    const ssize_t tile_rows = std::min(kTileSize, rows.size - i);
+    for (ssize_t j = 0; j < cols.size; j += kTileSize) {
+      const ssize_t tile_cols = std::min(kTileSize, cols.size - j);
+      CopyTileAnySize(
+          src + i * rows.stride + j * cols.stride, tile_rows, tile_cols,
+          rows.stride, cols.stride, dst + i * dst_row_stride + j * item_size,
+          dst_row_stride, item_size);
+    }
+  }
+}
+
+void
+NonTemporalCopy(char* dst, const char* src, size_t byte_size)
+{
+#if defined(__SSE2__)
+  // Align the destination to 16 bytes for the streaming stores.
+  size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+  head = std::min(head, byte_size);
+  std::memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  byte_size -= head;
+
+  const size_t body = byte_size & ~static_cast<size_t>(63);
+  for (size_t i = 0; i < body; i += 64) {
+    __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i v1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+    __m128i v2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+    __m128i v3 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 48), v3);
+  }
+  // Make the streaming stores visible before the copy is reported done.
+  _mm_sfence();
+  std::memcpy(dst + body, src + body, byte_size - body);
+#else
+  std::memcpy(dst, src, byte_size);
+#endif
+}
+
+void
+CopyChunk(char* dst, const char* src, size_t byte_size, bool non_temporal)
+{
+  if (non_temporal && (byte_size >= kMinNonTemporalByteSize)) {
+    NonTemporalCopy(dst, src, byte_size);
+  } else {
+    std::memcpy(dst, src, byte_size);
+  }
+}
+
+}  // namespace
+
+void
+StridedCopy(
+    const char* src, const ssize_t* shape, const ssize_t* strides,
+    size_t ndim, size_t item_size, char* dst)
+{
+  // Drop the dimensions of size 1 and merge the dimensions that are
+  // contiguous with each other, so that e.g. a slice of rows becomes a
+  // single 2-D copy.
+  std::vector<Dim> dims;
+  for (size_t i = 0; i < ndim; i++) {
+    if (shape[i] == 0) {
+      return;
+    }
+    if (shape[i] == 1) {
+      continue;
+    }
+    if (!dims.empty() && (dims.back().stride == strides[i] * shape[i])) {
+      dims.back().size *= shape[i];
+      dims.back().stride = strides[i];
+    } else {
+      dims.push_back({shape[i], strides[i]});
+    }
+  }
+
+  // Always copy at least a 2-D block.
+  while (dims.size() < 2) {
+    dims.insert(dims.begin(), Dim{1, 0});
+  }
+
+  const Dim& rows = dims[dims.size() - 2];
+  const Dim& cols = dims[dims.size() - 1];
+  const size_t outer_ndim = dims.size() - 2;
+  const size_t block_byte_size = rows.size * cols.size * item_size;
+
+  // Iterate over the outer dimensions in C order.
+  std::vector<ssize_t> index(outer_ndim, 0);
+  while (true) {
+    CopyInner(src, rows, cols, dst, item_size);
+    dst += block_byte_size;
+
+    ssize_t d = static_cast<ssize_t>(outer_ndim) - 1;
+    for (; d >= 0; d--) {
+      src += dims[d].stride;
+      if (++index[d] < dims[d].size) {
+        break;
+      }
+      src -= dims[d].stride * dims[d].size;
+      index[d] = 0;
+    }
+    if (d < 0) {
+      break;
+    }
+  }
+}
+
+CopyEngine::CopyEngine(size_t thread_count, size_t parallel_byte_size)
+    : parallel_byte_size_(std::max(parallel_byte_size, kMinChunkByteSize)),
+      exiting_(false), copy_count_(0), byte_size_(0), duration_ns_(0)
+{
+  // The calling thread copies one of the chunks.
+  for (size_t i = 1; i < thread_count; i++) {
+    workers_.emplace_back(&CopyEngine::WorkerLoop, this);
+  }
+}
+
+CopyEngine::~CopyEngine()
+{
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    exiting_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void
+CopyEngine::WorkerLoop()
+{
+  while (true) {
+    Chunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return exiting_ || !chunks_.empty(); });
+      if (chunks_.empty()) {
+        return;
+      }
+      chunk = chunks_.front();
+      chunks_.pop_front();
+    }
+
+    CopyChunk(chunk.dst, chunk.src, chunk.byte_size, chunk.non_temporal);
+
+    std::lock_guard<std::mutex> lock(chunk.latch->mu);
+    if (--chunk.latch->pending == 0) {
+      chunk.latch->cv.notify_one();
+    }
+  }
+}
+
+void
+CopyEngine::Copy(
+    char* dst, const char* src, size_t byte_size, bool non_temporal)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  const size_t chunk_count = std::min(
+      workers_.size() + 1, std::max<size_t>(byte_size / kMinChunkByteSize, 1));
+  if ((byte_size < parallel_byte_size_) || (chunk_count == 1)) {
+    CopyChunk(dst, src, byte_size, non_temporal);
+  } else {
+    // Chunks are multiples of the cache line size so that the threads do not
+    // write to the same lines.
+    const size_t chunk_byte_size =
+        ((byte_size / chunk_count) + 63) & ~static_cast<size_t>(63);
+    Latch latch;
+    latch.pending = 0;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      for (size_t offset = chunk_byte_size; offset < byte_size;
+           offset += chunk_byte_size) {
+        chunks_.push_back(
+            {dst + offset, src + offset,
+             std::min(chunk_byte_size, byte_size - offset), non_temporal,
+             &latch});
+        latch.pending++;
+      }
+    }
+    cv_.notify_all();
+
+    CopyChunk(dst, src, chunk_byte_size, non_temporal);
+
+    std::unique_lock<std::mutex> lock(latch.mu);
+    latch.cv.wait(lock, [&latch] { return latch.pending == 0; });
+  }
+
+  copy_count_++;
+  byte_size_ += byte_size;
+  duration_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+CopyStats
+CopyEngine::Stats() const
+{
+  return {copy_count_.load(), byte_size_.load(), duration_ns_.load()};
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,106 @@
+// Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+
+// Copy the elements of a strided array in 'src' to 'dst' in C order. 'shape'
+// and 'strides' have 'ndim' entries. 'strides' are in bytes and may be
+// negative or zero, as in the buffer protocol.
+void StridedCopy(
+    const char* src, const ssize_t* shape, const ssize_t* strides,
+    size_t ndim, size_t item_size, char* dst);
+
+// Statistics of the copies done by a CopyEngine.
+struct CopyStats {
+  uint64_t copy_count;
+  uint64_t byte_size;
+  uint64_t duration_ns;
+};
+
+//
+// CopyEngine
+//
+// Copies large host buffers, e.g. tensors to and from the shared memory.
+// Copies of at least 'parallel_byte_size' bytes are split across
+// 'thread_count' threads, including the calling thread. Destinations that are
+// not read again soon, by this process or by the other processes sharing the
+// last-level cache, can be written with non-temporal stores, which bypass the
+// cache.
+//
+class CopyEngine {
+ public:
+  CopyEngine(size_t thread_count, size_t parallel_byte_size);
+  ~CopyEngine();
+
+  // Copy 'byte_size' bytes from 'src' to 'dst'. The buffers must not
+  // overlap. Can be called from several threads at the same time.
+  void Copy(char* dst, const char* src, size_t byte_size, bool non_temporal);
+
+  CopyStats Stats() const;
+
+ private:
+  // Completion of the chunks of a single copy.
+  struct Latch {
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t pending;
+  };
+
+  struct Chunk {
+    char* dst;
+    const char* src;
+    size_t byte_size;
+    bool non_temporal;
+    Latch* latch;
+  };
+
+  void WorkerLoop();
+
+  size_t parallel_byte_size_;
+  std::vector<std::thread> workers_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Chunk> chunks_;
+  bool exiting_;
+
+  std::atomic<uint64_t> copy_count_;
+  std::atomic<uint64_t> byte_size_;
+  std::atomic<uint64_t> duration_ns_;
+};
+
+}}}  // namespace triton::backend::python
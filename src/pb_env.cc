@@ -28,11 +28,23 @@
 
 #include <archive.h>
 #include <archive_entry.h>
+#include <dirent.h>
 #include <fts.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include "pb_utils.h"
+#include "triton/backend/backend_common.h"
 
 
 namespace triton { namespace backend { namespace python {
@@ -86,8 +98,131 @@ RecursiveDirectoryDelete(const char* dir)
   fts_close(ftsp);
 }
 
-EnvironmentManager::EnvironmentManager()
+// Prefix of the temporary directories in the cache, followed by the host name
+// and the pid of the process that extracts an environment to it.
+constexpr char kExtractionPrefix[] = ".tmp-";
+
+// Suffix of the lock file that the process extracting an environment holds
+// next to the temporary directory, which has the same name without it.
+constexpr char kExtractionLockSuffix[] = ".lock";
+
+// Whether the file descriptor 'fd' is still open on the file 'path', which
+// can have been deleted, and maybe recreated, by another process.
+bool
+IsOpenFile(const int fd, const std::string& path)
+{
+  struct stat fd_stat;
+  struct stat path_stat;
+  return (fstat(fd, &fd_stat) == 0) && (stat(path.c_str(), &path_stat) == 0) &&
+         (fd_stat.st_dev == path_stat.st_dev) &&
+         (fd_stat.st_ino == path_stat.st_ino);
+}
+
+std::string
+HostName()
+{
+  char host_name[HOST_NAME_MAX + 1] = {};
+  gethostname(host_name, HOST_NAME_MAX);
+  return host_name;
+}
+
+// FNV-1a hash of the content of the file 'path'
+uint64_t
+FileHash(const char* path)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    throw PythonBackendException(
+        std::string("Failed to open ") + path + ": " + strerror(errno));
+  }
+
+  uint64_t hash = 14695981039346656037ULL;
+  std::vector<unsigned char> buffer(1024 * 1024);
+  size_t read_size;
+  while ((read_size = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+    for (size_t i = 0; i < read_size; i++) {
+      hash = (hash ^ buffer[i]) * 1099511628211ULL;
+    }
+  }
+  fclose(file);
+
+  return hash;
+}
+
+// Extract the environment 'archive_path' to 'dst_path' and log the
+// extraction throughput.
+void
+ExtractEnvironment(std::string& archive_path, std::string& dst_path)
 {
+  // The files are written by several threads, since creating many small
+  // files is often slower than decompressing them.
+  size_t writer_thread_count =
+      std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+  ExtractionStats stats =
+      ExtractTarFile(archive_path, dst_path, writer_thread_count);
+
+  uint64_t duration_ms = std::max<uint64_t>(1, stats.duration_ns / 1000000);
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_INFO,
+      (std::string("Extracted Python environment ") + archive_path + " (" +
+       std::to_string(stats.entry_count) + " entries, " +
+       std::to_string(stats.byte_size / (1024 * 1024)) + " MiB) in " +
+       std::to_string(duration_ms) + " ms, " +
+       std::to_string(stats.byte_size * 1000 / duration_ms / (1024 * 1024)) +
+       " MiB/s")
+          .c_str());
+}
+
+// Whether the files 'path' and 'other_path' have the same content
+bool
+SameFileContent(const char* path, const char* other_path)
+{
+  FILE* file = fopen(path, "rb");
+  FILE* other_file = fopen(other_path, "rb");
+  bool same = (file != nullptr && other_file != nullptr);
+  std::vector<char> buffer(1024 * 1024);
+  std::vector<char> other_buffer(buffer.size());
+  while (same) {
+    size_t read_size = fread(buffer.data(), 1, buffer.size(), file);
+    size_t other_read_size =
+        fread(other_buffer.data(), 1, other_buffer.size(), other_file);
+    same = (read_size == other_read_size) &&
+           (memcmp(buffer.data(), other_buffer.data(), read_size) == 0);
+    if (read_size == 0) {
+      break;
+    }
+  }
+  if (file != nullptr) {
+    fclose(file);
+  }
+  if (other_file != nullptr) {
+    fclose(other_file);
+  }
+
+  return same;
+}
+
+EnvironmentManager::EnvironmentManager(const std::string& cache_path)
+    : env_map_(std::make_shared<ResultMap<std::string>>()), env_count_(0),
+      cache_path_(cache_path),
+      activated_env_map_(
+          std::make_shared<ResultMap<std::vector<std::string>>>())
+{
+  if (!cache_path_.empty()) {
+    for (const std::string& path :
+         {cache_path_, cache_path_ + "/envs", cache_path_ + "/objects"}) {
+      if (mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) != 0 &&
+          errno != EEXIST) {
+        throw PythonBackendException(
+            std::string("Failed to create the Python environment cache '") +
+            path + "': " + strerror(errno));
+      }
+    }
+    DeleteStaleExtractions();
+    base_path_[0] = '\0';
+    return;
+  }
+
   char tmp_dir_template[PATH_MAX + 1];
   strcpy(tmp_dir_template, "/tmp/python_env_XXXXXX");
 
@@ -99,11 +234,68 @@ EnvironmentManager::EnvironmentManager()
   strcpy(base_path_, tmp_dir_template);
 }
 
+// Get the result for 'key' in '*map', which is created by 'create' and
+// added to the map under 'mutex' if it is not there yet. A failed result is
+// removed from the map, so that the next call creates it again.
+template <typename T>
+const T&
+GetOrCreateResult(
+    std::mutex& mutex,
+    std::shared_ptr<const EnvironmentManager::ResultMap<T>>* map,
+    const std::string& key, const std::function<T()>& create)
+{
+  auto snapshot = std::atomic_load(map);
+  auto it = snapshot->find(key);
+  if (it != snapshot->end()) {
+    return it->second.get();
+  }
+
+  std::promise<T> promise;
+  std::shared_future<T> result;
+  bool creating = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = std::atomic_load(map);
+    it = snapshot->find(key);
+    if (it != snapshot->end()) {
+      result = it->second;
+    } else {
+      result = promise.get_future().share();
+      auto updated_map =
+          std::make_shared<EnvironmentManager::ResultMap<T>>(*snapshot);
+      updated_map->emplace(key, result);
+      std::atomic_store(
+          map, std::shared_ptr<const EnvironmentManager::ResultMap<T>>(
+                   updated_map));
+      creating = true;
+    }
+  }
+
+  if (creating) {
+    try {
+      promise.set_value(create());
+    }
+    catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto updated_map = std::make_shared<EnvironmentManager::ResultMap<T>>(
+            *std::atomic_load(map));
+        updated_map->erase(key);
+        std::atomic_store(
+            map, std::shared_ptr<const EnvironmentManager::ResultMap<T>>(
+                     updated_map));
+      }
+      promise.set_exception(std::current_exception());
+    }
+  }
+
+  // The map keeps the result alive once it is set.
+  return result.get();
+}
+
 std::string
 EnvironmentManager::ExtractIfNotExtracted(std::string env_path)
 {
-  // Lock the mutex. Only a single thread should modify the map.
-  std::lock_guard<std::mutex> lk(mutex_);
   char canonical_env_path[PATH_MAX + 1];
 
   char* err = realpath(env_path.c_str(), canonical_env_path);
@@ -113,33 +305,300 @@ EnvironmentManager::ExtractIfNotExtracted(std::string env_path)
   }
 
   // Extract only if the env has not been extracted yet.
-  if (env_map_.find(canonical_env_path) == env_map_.end()) {
-    std::string dst_env_path(
-        std::string(base_path_) + "/" + std::to_string(env_map_.size()));
+  std::string archive_path(canonical_env_path);
+  return GetOrCreateResult<std::string>(
+      mutex_, &env_map_, archive_path, [this, &archive_path] {
+        if (!cache_path_.empty()) {
+          return ExtractToCache(archive_path);
+        }
+        return ExtractToTemporaryDirectory(archive_path);
+      });
+}
+
+std::string
+EnvironmentManager::ExtractToTemporaryDirectory(
+    const std::string& archive_path)
+{
+  std::string dst_env_path(
+      std::string(base_path_) + "/" + std::to_string(env_count_++));
 
-    std::string canonical_env_path_str(canonical_env_path);
+  std::string canonical_env_path_str(archive_path);
 
-    int status =
-        mkdir(dst_env_path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-    if (status == 0) {
-      ExtractTarFile(canonical_env_path_str, dst_env_path);
-    } else {
+  int status =
+      mkdir(dst_env_path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  if (status == 0) {
+    ExtractEnvironment(canonical_env_path_str, dst_env_path);
+  } else {
+    throw PythonBackendException(
+        std::string("Failed to create environment directory for '") +
+        dst_env_path.c_str() + "'.");
+  }
+
+  return dst_env_path;
+}
+
+std::string
+EnvironmentManager::ExtractToCache(const std::string& archive_path)
+{
+  struct stat archive_stat;
+  if (stat(archive_path.c_str(), &archive_stat) != 0) {
+    throw PythonBackendException(
+        std::string("Failed to stat the Python environment '") + archive_path +
+        "': " + strerror(errno));
+  }
+
+  std::string archive_name =
+      archive_path.substr(archive_path.find_last_of('/') + 1);
+  std::string env_path =
+      cache_path_ + "/envs/" + archive_name + "-" +
+      std::to_string(archive_stat.st_size) + "-" +
+      std::to_string(
+          archive_stat.st_mtim.tv_sec * 1000000000LL +
+          archive_stat.st_mtim.tv_nsec) +
+      "-" + std::to_string(archive_stat.st_ino);
+  if (FileExists(env_path)) {
+    return env_path;
+  }
+
+  // The environment is extracted to a temporary directory, and then renamed,
+  // so that the other processes using the cache only see it once it is
+  // complete. The lock file of the directory is held during the extraction,
+  // so that the directory is only deleted by the other processes once this
+  // one has exited.
+  std::string lock_path;
+  int lock_fd = CreateExtractionLock(&lock_path);
+  std::string src_path = archive_path;
+  std::string dst_path =
+      lock_path.substr(0, lock_path.size() - strlen(kExtractionLockSuffix));
+  try {
+    if (mkdir(dst_path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) != 0) {
+      throw PythonBackendException(
+          std::string("Failed to create a directory in the Python environment "
+                      "cache: ") +
+          strerror(errno));
+    }
+    ExtractEnvironment(src_path, dst_path);
+    DeduplicateFiles(dst_path);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    if (FileExists(dst_path)) {
+      RecursiveDirectoryDelete(dst_path.c_str());
+    }
+    unlink(lock_path.c_str());
+    close(lock_fd);
+    throw;
+  }
+
+  int rename_errno = 0;
+  if (rename(dst_path.c_str(), env_path.c_str()) != 0) {
+    rename_errno = errno;
+    RecursiveDirectoryDelete(dst_path.c_str());
+  }
+  unlink(lock_path.c_str());
+  close(lock_fd);
+
+  if (rename_errno != 0) {
+    // Another process has published the same environment in the meantime.
+    if (rename_errno != EEXIST && rename_errno != ENOTEMPTY) {
       throw PythonBackendException(
-          std::string("Failed to create environment directory for '") +
-          dst_env_path.c_str() + "'.");
+          std::string("Failed to add the Python environment '") +
+          archive_path + "' to the cache: " + strerror(rename_errno));
     }
+  }
 
-    // Add the path to the list of environments
-    env_map_.insert({canonical_env_path, dst_env_path});
-    return dst_env_path;
-  } else {
-    return env_map_.find(canonical_env_path)->second;
+  return env_path;
+}
+
+void
+EnvironmentManager::DeduplicateFiles(const std::string& dir)
+{
+  char* files[] = {(char*)dir.c_str(), NULL};
+  FTS* ftsp = fts_open(files, FTS_NOCHDIR | FTS_PHYSICAL | FTS_XDEV, NULL);
+  if (!ftsp) {
+    throw PythonBackendException(
+        std::string("Failed to open ") + dir + ": " + strerror(errno));
+  }
+
+  // The files are identified by their size, mode, modification time and the
+  // hash of their content, since the modification time of the Python sources
+  // is checked against their compiled files. Deduplication is skipped when
+  // the links can't be created, e.g. on file systems without hard links.
+  FTSENT* curr;
+  while ((curr = fts_read(ftsp))) {
+    const struct stat* file_stat = curr->fts_statp;
+    if (curr->fts_info != FTS_F || file_stat->st_nlink != 1) {
+      continue;
+    }
+
+    std::string object_path;
+    try {
+      std::stringstream object_name;
+      object_name << file_stat->st_size << "-" << std::oct
+                  << file_stat->st_mode << std::dec << "-"
+                  << file_stat->st_mtim.tv_sec << "-" << std::hex
+                  << FileHash(curr->fts_path);
+      object_path = cache_path_ + "/objects/" + object_name.str();
+    }
+    catch (const PythonBackendException& pb_exception) {
+      fts_close(ftsp);
+      throw;
+    }
+
+    if (link(curr->fts_path, object_path.c_str()) == 0 || errno != EEXIST ||
+        !SameFileContent(curr->fts_path, object_path.c_str())) {
+      continue;
+    }
+
+    // The file is replaced atomically by a link to the identical one.
+    std::string link_path = std::string(curr->fts_path) + ".pb_link";
+    if (link(object_path.c_str(), link_path.c_str()) == 0 &&
+        rename(link_path.c_str(), curr->fts_path) != 0) {
+      unlink(link_path.c_str());
+    }
+  }
+
+  fts_close(ftsp);
+}
+
+int
+EnvironmentManager::CreateExtractionLock(std::string* lock_path)
+{
+  const size_t suffix_length = strlen(kExtractionLockSuffix);
+  while (true) {
+    std::string lock_template =
+        cache_path_ + "/" + kExtractionPrefix + HostName() + "-" +
+        std::to_string(getpid()) + "-XXXXXX" + kExtractionLockSuffix;
+    std::vector<char> path(lock_template.begin(), lock_template.end());
+    path.push_back('\0');
+    int fd = mkstemps(path.data(), suffix_length);
+    if (fd == -1) {
+      throw PythonBackendException(
+          std::string("Failed to create a lock file in the Python environment "
+                      "cache: ") +
+          strerror(errno));
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+      int flock_errno = errno;
+      unlink(path.data());
+      close(fd);
+      throw PythonBackendException(
+          std::string("Failed to lock a file in the Python environment "
+                      "cache: ") +
+          strerror(flock_errno));
+    }
+
+    // Another process can have found the file unlocked and deleted it before
+    // it was locked.
+    *lock_path = path.data();
+    if (IsOpenFile(fd, *lock_path)) {
+      fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      return fd;
+    }
+    close(fd);
+  }
+}
+
+void
+EnvironmentManager::DeleteStaleExtractions()
+{
+  DIR* dir = opendir(cache_path_.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+
+  const size_t prefix_length = strlen(kExtractionPrefix);
+  const size_t suffix_length = strlen(kExtractionLockSuffix);
+  std::vector<std::string> lock_paths;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if ((name.size() > prefix_length + suffix_length) &&
+        (name.compare(0, prefix_length, kExtractionPrefix) == 0) &&
+        (name.compare(
+             name.size() - suffix_length, suffix_length,
+             kExtractionLockSuffix) == 0)) {
+      lock_paths.push_back(cache_path_ + "/" + name);
+    }
+  }
+  closedir(dir);
+
+  // A lock file that can be locked belongs to an extraction whose process has
+  // exited, whatever host or PID namespace it ran in. The directory is deleted
+  // before the lock file, so that it is never left without one.
+  for (const std::string& lock_path : lock_paths) {
+    int fd = open(lock_path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      continue;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0 && IsOpenFile(fd, lock_path)) {
+      std::string stale_path =
+          lock_path.substr(0, lock_path.size() - suffix_length);
+      if (FileExists(stale_path)) {
+        RecursiveDirectoryDelete(stale_path.c_str());
+      }
+      unlink(lock_path.c_str());
+    }
+    close(fd);
   }
 }
 
+// Get the environment variables after sourcing the 'activate' script of the
+// extracted environment 'extracted_env_path'.
+std::vector<std::string>
+ActivateEnvironment(const std::string& extracted_env_path)
+{
+  // Need to properly set the LD_LIBRARY_PATH so that Python environments
+  // using different python versions load properly. The variables are printed
+  // separated by null characters, since the values can contain new lines.
+  // Whatever the activate script prints is discarded so that it is not mixed
+  // with the variables.
+  std::string command = "bash -c 'export LD_LIBRARY_PATH=" +
+                        extracted_env_path +
+                        "/lib:$LD_LIBRARY_PATH; source " + extracted_env_path +
+                        "/bin/activate >/dev/null && env -0'";
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    throw PythonBackendException(
+        std::string("Failed to activate the Python environment in '") +
+        extracted_env_path + "'.");
+  }
+
+  std::vector<std::string> variables;
+  std::string variable;
+  int c;
+  while ((c = fgetc(pipe)) != EOF) {
+    if (c == '\0') {
+      variables.push_back(variable);
+      variable.clear();
+    } else {
+      variable.push_back(c);
+    }
+  }
+
+  if (pclose(pipe) != 0 || variables.empty()) {
+    throw PythonBackendException(
+        std::string("Failed to activate the Python environment in '") +
+        extracted_env_path + "'.");
+  }
+
+  return variables;
+}
+
+const std::vector<std::string>&
+EnvironmentManager::ActivatedEnvironment(const std::string& extracted_env_path)
+{
+  return GetOrCreateResult<std::vector<std::string>>(
+      mutex_, &activated_env_map_, extracted_env_path,
+      [&extracted_env_path] {
+        return ActivateEnvironment(extracted_env_path);
+      });
+}
+
 EnvironmentManager::~EnvironmentManager()
 {
-  RecursiveDirectoryDelete(base_path_);
+  // The environments in the cache are kept for the next processes.
+  if (cache_path_.empty()) {
+    RecursiveDirectoryDelete(base_path_);
+  }
 }
 
 }}}  // namespace triton::backend::python
@@ -25,27 +25,95 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include <atomic>
 #include <climits>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace triton { namespace backend { namespace python {
 
 //
 // A class that manages Python environments
 //
+// The environments are extracted to a temporary directory that is deleted
+// with the manager, or to a persistent cache directory that is shared by the
+// processes using it. An environment in the cache is named after the size,
+// modification time and inode of its archive, and is only extracted again if
+// the archive changes. Identical files of the environments in the cache are
+// hard links to a single copy.
+//
+// Each environment is extracted and activated once, by the first thread that
+// needs it, while the other threads wait for the result. Different
+// environments are extracted concurrently.
+//
 class EnvironmentManager {
-  std::map<std::string, std::string> env_map_;
+ public:
+  // The results of the extractions or activations, indexed by environment.
+  // A map is never modified once it is published, but replaced by an updated
+  // copy, so that it can be read without locking.
+  template <typename T>
+  using ResultMap = std::map<std::string, std::shared_future<T>>;
+
+ private:
+  // Paths of the extracted environments, indexed by the canonical path of
+  // their archive.
+  std::shared_ptr<const ResultMap<std::string>> env_map_;
+
+  // Number of environments extracted to 'base_path_'
+  std::atomic<size_t> env_count_;
+
+  // Path to the cache directory, empty if the environments are extracted to
+  // 'base_path_'.
+  std::string cache_path_;
+
+  // Variables of the activated environments, indexed by the path of the
+  // extracted environment.
+  std::shared_ptr<const ResultMap<std::vector<std::string>>>
+      activated_env_map_;
   char base_path_[PATH_MAX + 1];
+
+  // Serializes the updates of the maps
   std::mutex mutex_;
 
+  // Extract the archive 'archive_path' to 'base_path_' and return the path
+  // of the extracted environment.
+  std::string ExtractToTemporaryDirectory(const std::string& archive_path);
+
+  // Extract the archive 'archive_path' to the cache if it is not there yet,
+  // and return the path of the extracted environment.
+  std::string ExtractToCache(const std::string& archive_path);
+
+  // Replace the regular files in 'dir' by hard links to the identical files
+  // already in the cache, and add the other ones to the cache.
+  void DeduplicateFiles(const std::string& dir);
+
+  // Create and lock the lock file of a new temporary directory of the cache,
+  // and return its file descriptor. The directory is named after
+  // '*lock_path' without its suffix.
+  int CreateExtractionLock(std::string* lock_path);
+
+  // Delete the temporary directories left in the cache by the processes that
+  // have exited during an extraction, which no longer hold their lock file.
+  void DeleteStaleExtractions();
+
  public:
-  EnvironmentManager();
+  // Creates a manager that extracts the environments to 'cache_path', or to
+  // a temporary directory if 'cache_path' is empty.
+  explicit EnvironmentManager(const std::string& cache_path = "");
 
   // Extracts the tar.gz file in the 'env_path' if it has not been
   // already extracted.
   std::string ExtractIfNotExtracted(std::string env_path);
+
+  // Get the environment variables of this process after sourcing the
+  // 'activate' script of the extracted environment 'extracted_env_path', as
+  // "NAME=value" strings. The script is only run the first time.
+  const std::vector<std::string>& ActivatedEnvironment(
+      const std::string& extracted_env_path);
   ~EnvironmentManager();
 };
 
@@ -27,19 +27,33 @@
 #include <pybind11/embed.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
+#include <poll.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/thread/thread_time.hpp>
+#include <condition_variable>
+#include <deque>
+#include <dlpack/dlpack.h>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <thread>
 #include <unordered_map>
+#include "pb_copy.h"
 #include "pb_utils.h"
 #include "shm_manager.h"
 
@@ -123,6 +137,231 @@ SigtermHandler(int signum)
   sigterm_received = true;
 }
 
+// Names of the capsules holding a DLManagedTensor, as defined by the Python
+// specification of DLPack. A consumer renames the capsule once it has taken
+// the ownership of the tensor.
+constexpr char kDLTensorCapsuleName[] = "dltensor";
+constexpr char kUsedDLTensorCapsuleName[] = "used_dltensor";
+
+// Boolean type code, introduced after DLPack v0.5.
+constexpr uint8_t kDLBoolCode = 6;
+
+TRITONSERVER_DataType
+DLDataTypeToTriton(const DLDataType& dl_dtype)
+{
+  if (dl_dtype.lanes != 1) {
+    return TRITONSERVER_TYPE_INVALID;
+  }
+
+  switch (dl_dtype.code) {
+    case kDLInt:
+      switch (dl_dtype.bits) {
+        case 8:
+          return TRITONSERVER_TYPE_INT8;
+        case 16:
+          return TRITONSERVER_TYPE_INT16;
+        case 32:
+          return TRITONSERVER_TYPE_INT32;
+        case 64:
+          return TRITONSERVER_TYPE_INT64;
+      }
+      break;
+    case kDLUInt:
+      switch (dl_dtype.bits) {
+        case 8:
+          return TRITONSERVER_TYPE_UINT8;
+        case 16:
+          return TRITONSERVER_TYPE_UINT16;
+        case 32:
+          return TRITONSERVER_TYPE_UINT32;
+        case 64:
+          return TRITONSERVER_TYPE_UINT64;
+      }
+      break;
+    case kDLFloat:
+      switch (dl_dtype.bits) {
+        case 16:
+          return TRITONSERVER_TYPE_FP16;
+        case 32:
+          return TRITONSERVER_TYPE_FP32;
+        case 64:
+          return TRITONSERVER_TYPE_FP64;
+      }
+      break;
+    case kDLBoolCode:
+      if (dl_dtype.bits == 8) {
+        return TRITONSERVER_TYPE_BOOL;
+      }
+      break;
+  }
+
+  return TRITONSERVER_TYPE_INVALID;
+}
+
+// Take the ownership of the DLManagedTensor exported by 'dlpack_tensor',
+// which is either a DLPack capsule or an object implementing '__dlpack__'.
+// The returned capsule calls the deleter of the tensor when it is destroyed.
+py::capsule
+ConsumeDLPack(py::handle dlpack_tensor, DLManagedTensor** managed_tensor)
+{
+  py::object capsule = py::reinterpret_borrow<py::object>(dlpack_tensor);
+  if (py::hasattr(dlpack_tensor, "__dlpack__")) {
+    capsule = dlpack_tensor.attr("__dlpack__")();
+  }
+
+  if (!PyCapsule_IsValid(capsule.ptr(), kDLTensorCapsuleName)) {
+    throw PythonBackendException(
+        "Expected a DLPack capsule or an object implementing __dlpack__. "
+        "Note that a DLPack capsule can only be consumed once.");
+  }
+
+  *managed_tensor = static_cast<DLManagedTensor*>(
+      PyCapsule_GetPointer(capsule.ptr(), kDLTensorCapsuleName));
+  PyCapsule_SetName(capsule.ptr(), kUsedDLTensorCapsuleName);
+
+  return py::capsule(*managed_tensor, [](void* ptr) {
+    DLManagedTensor* tensor = static_cast<DLManagedTensor*>(ptr);
+    if (tensor->deleter != nullptr) {
+      tensor->deleter(tensor);
+    }
+  });
+}
+
+// Keeps the numpy array exported through DLPack alive until the consumer
+// calls the deleter.
+struct NumpyDLPackContext {
+  DLManagedTensor managed_tensor;
+  py::object array;
+  std::vector<int64_t> shape;
+  std::vector<int64_t> strides;
+};
+
+// Export the buffer of 'array' as a DLPack capsule without copying it.
+py::capsule
+NumpyToDLPack(py::array array)
+{
+  DLDataType dl_dtype;
+  dl_dtype.bits = array.itemsize() * 8;
+  dl_dtype.lanes = 1;
+  switch (array.dtype().kind()) {
+    case 'b':
+      dl_dtype.code = kDLBoolCode;
+      break;
+    case 'i':
+      dl_dtype.code = kDLInt;
+      break;
+    case 'u':
+      dl_dtype.code = kDLUInt;
+      break;
+    case 'f':
+      dl_dtype.code = kDLFloat;
+      break;
+    default:
+      throw PythonBackendException(
+          "Only boolean, integer and floating point tensors can be exported "
+          "through DLPack.");
+  }
+
+  std::unique_ptr<NumpyDLPackContext> context(new NumpyDLPackContext());
+  for (ssize_t i = 0; i < array.ndim(); i++) {
+    // DLPack strides are in elements.
+    if (array.strides(i) % array.itemsize() != 0) {
+      throw PythonBackendException(
+          "Cannot export a tensor whose strides are not a multiple of its "
+          "element size through DLPack.");
+    }
+    context->shape.push_back(array.shape(i));
+    context->strides.push_back(array.strides(i) / array.itemsize());
+  }
+  context->array = array;
+
+  DLTensor& dl_tensor = context->managed_tensor.dl_tensor;
+  dl_tensor.data = const_cast<void*>(array.data());
+  dl_tensor.device = {kDLCPU, 0};
+  dl_tensor.ndim = array.ndim();
+  dl_tensor.dtype = dl_dtype;
+  dl_tensor.shape = context->shape.data();
+  dl_tensor.strides = context->strides.data();
+  dl_tensor.byte_offset = 0;
+  context->managed_tensor.manager_ctx = context.get();
+  context->managed_tensor.deleter = [](DLManagedTensor* self) {
+    // The deleter may be called by a consumer without holding the GIL.
+    py::gil_scoped_acquire acquire;
+    delete static_cast<NumpyDLPackContext*>(self->manager_ctx);
+  };
+
+  py::capsule capsule(
+      &context.release()->managed_tensor, kDLTensorCapsuleName,
+      [](PyObject* capsule) {
+        // The tensor is owned by the consumer once the capsule is renamed.
+        if (PyCapsule_IsValid(capsule, kDLTensorCapsuleName)) {
+          DLManagedTensor* tensor = static_cast<DLManagedTensor*>(
+              PyCapsule_GetPointer(capsule, kDLTensorCapsuleName));
+          tensor->deleter(tensor);
+        }
+      });
+  return capsule;
+}
+
+// Wrap the tensor exported by 'dlpack_tensor' in a numpy array without
+// copying it. The array keeps the tensor alive.
+py::array
+DLPackToNumpy(py::handle dlpack_tensor)
+{
+  DLManagedTensor* managed_tensor;
+  py::capsule owner = ConsumeDLPack(dlpack_tensor, &managed_tensor);
+  const DLTensor& dl_tensor = managed_tensor->dl_tensor;
+
+  if (dl_tensor.device.device_type != kDLCPU &&
+      dl_tensor.device.device_type != kDLCUDAHost) {
+    throw PythonBackendException(
+        "Only DLPack tensors in the CPU memory can be used.");
+  }
+
+  if (DLDataTypeToTriton(dl_tensor.dtype) == TRITONSERVER_TYPE_INVALID) {
+    throw PythonBackendException("DLPack data type is not supported.");
+  }
+
+  const char* kind = dl_tensor.dtype.code == kDLInt     ? "i"
+                     : dl_tensor.dtype.code == kDLUInt  ? "u"
+                     : dl_tensor.dtype.code == kDLFloat ? "f"
+                                                        : "b";
+  size_t item_size = dl_tensor.dtype.bits / 8;
+  py::dtype dtype_numpy(kind + std::to_string(item_size));
+
+  std::vector<ssize_t> shape(dl_tensor.shape, dl_tensor.shape + dl_tensor.ndim);
+  std::vector<ssize_t> strides(dl_tensor.ndim);
+  ssize_t stride = item_size;
+  for (int i = dl_tensor.ndim - 1; i >= 0; i--) {
+    if (dl_tensor.strides != nullptr) {
+      strides[i] = dl_tensor.strides[i] * item_size;
+    } else {
+      strides[i] = stride;
+      stride *= shape[i];
+    }
+  }
+
+  char* data = static_cast<char*>(dl_tensor.data) + dl_tensor.byte_offset;
+  return py::array(dtype_numpy, shape, strides, data, owner);
+}
+
+PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
+{
+  module.def("to_dlpack", &NumpyToDLPack);
+  module.def("from_dlpack", &DLPackToNumpy);
+}
+
+// Get the copy engine of the stub process, which the stubs of a shared stub
+// process use together, so that the process has a single pool of copy
+// threads. It is created by the first stub with its arguments, which are
+// settings of the backend and thus the same for every stub.
+CopyEngine*
+ProcessCopyEngine(int64_t thread_count, int64_t parallel_byte_size)
+{
+  static CopyEngine copy_engine(thread_count, parallel_byte_size);
+  return &copy_engine;
+}
+
 class Stub {
   bi::interprocess_mutex* stub_mutex_;
   bi::interprocess_condition* stub_cond_;
@@ -135,82 +374,217 @@ class Stub {
   std::unique_ptr<SharedMemory> shm_pool_;
   py::object PyRequest_;
   py::object PyTensor_;
+  py::object PyResponseSender_;
+  py::object is_coroutine_;
+  py::object is_async_generator_;
+  py::object is_awaitable_;
+  py::object iterate_async_generator_;
+  py::object complete_responses_;
   py::object model_instance_;
   py::object deserialize_bytes_;
   py::object serialize_bytes_;
   ResponseBatch* response_batch_;
+  CopyEngine* copy_engine_;
+
+  // Whether the model uses the decoupled transaction policy, in which case
+  // each request gets a response sender instead of returning its responses.
+  bool decoupled_;
+
+  // State of the current request batch. 'next_completed_' points to where the
+  // offset of the next entry of the completion queue is published.
+  std::vector<std::unordered_map<std::string, off_t>> requested_output_names_;
+  std::vector<bool> final_response_sent_;
+  off_t* next_completed_;
+
+  // Offset of the first response of the current request batch, where the
+  // responses are allocated again once the parent has released them.
+  off_t responses_offset_;
+  std::atomic<bool> sending_responses_;
+
+  // Set once the parent process has aborted the stub, see AbortRequested.
+  std::atomic<bool> aborting_;
+
+  // Threads that execute sub-batches at the same time as the main thread, see
+  // ExecuteConcurrently.
+  std::vector<std::thread> execute_threads_;
+  std::deque<std::function<void()>> execute_tasks_;
+  std::mutex execute_mu_;
+  std::condition_variable execute_cv_;
+  bool exiting_;
+
+  // Protects the shared memory pool and the completion queue while responses
+  // are sent, since concurrent executions and the Python threads of decoupled
+  // models send them from several threads. ProcessResponse releases the GIL
+  // while holding it, so it must never be waited for while holding the GIL,
+  // see LockResponses.
+  std::mutex response_mu_;
+
+  // Everything below this offset in the shared memory was allocated before
+  // the current request batch and stays valid while the stub is running,
+  // e.g. the names of the tensors with fixed dims.
+  off_t request_batch_offset_;
+
+  // Python names of the tensors, indexed by the offset of the name. Only the
+  // names allocated below 'request_batch_offset_' are cached.
+  std::unordered_map<off_t, py::object> tensor_names_;
+
+  // Event loops that run `async` execute, indexed by thread. Only accessed
+  // while holding the GIL.
+  std::unordered_map<std::thread::id, py::object> event_loops_;
+
+  // A tensor in the shared memory, mapped without holding the GIL.
+  struct MappedTensor {
+    off_t name;
+    TRITONSERVER_DataType dtype;
+    char* data;
+    uint64_t byte_size;
+    std::vector<int64_t> shape;
+  };
+
+  // The batch inputs of a request batch, which are loaded as Python tensors
+  // on first use.
+  struct LazyBatchInputs {
+    std::vector<MappedTensor> mapped_tensors;
+    py::dict tensors;
+    bool loaded;
+  };
+
+  // A request in the shared memory, mapped without holding the GIL.
+  struct MappedRequest {
+    char* id;
+    uint64_t correlation_id;
+    std::vector<MappedTensor> inputs;
+    std::vector<char*> requested_output_names;
+    off_t* requested_output_name_offsets;
+  };
+
+  // An output tensor read from a Python response, before it is written to
+  // the shared memory. 'owner' keeps 'data_ptr' alive.
+  struct OutputTensor {
+    off_t name;
+    TRITONSERVER_DataType dtype;
+    char* data_ptr;
+    ssize_t byte_size;
+    size_t item_size;
+    std::vector<ssize_t> shape;
+    std::vector<ssize_t> strides;  // In bytes
+    bool contiguous;
+    py::object owner;
+  };
+
+  // Numpy data types indexed by the Triton data type
+  std::unordered_map<int, py::dtype> numpy_dtypes_;
 
  public:
   Stub(
       int64_t shm_growth_size, int64_t shm_default_size,
-      std::string& shm_region_name, std::string& model_path)
+      std::string& shm_region_name, std::string& model_path,
+      int64_t copy_thread_count, int64_t copy_parallel_byte_size,
+      int64_t execute_thread_count)
   {
-    try {
-      model_path_ = model_path;
-      stub_mutex_ = nullptr;
-      stub_cond_ = nullptr;
-      parent_mutex_ = nullptr;
-      parent_cond_ = nullptr;
-      health_mutex_ = nullptr;
-
-      shm_pool_ = std::make_unique<SharedMemory>(
-          shm_region_name, shm_default_size, shm_growth_size);
-
-      // Stub mutex and CV
-      bi::interprocess_mutex* stub_mutex;
-      off_t stub_mutex_offset;
-      shm_pool_->Map(
-          (char**)&stub_mutex, sizeof(bi::interprocess_mutex),
-          stub_mutex_offset);
+    model_path_ = model_path;
+    copy_engine_ =
+        ProcessCopyEngine(copy_thread_count, copy_parallel_byte_size);
+    stub_mutex_ = nullptr;
+    stub_cond_ = nullptr;
+    parent_mutex_ = nullptr;
+    parent_cond_ = nullptr;
+    health_mutex_ = nullptr;
+    request_batch_offset_ = 0;
+    decoupled_ = false;
+    next_completed_ = nullptr;
+    responses_offset_ = 0;
+    sending_responses_ = false;
+    aborting_ = false;
+    exiting_ = false;
+
+    shm_pool_ = std::make_unique<SharedMemory>(
+        shm_region_name, shm_default_size, shm_growth_size);
+
+    // Stub mutex and CV
+    bi::interprocess_mutex* stub_mutex;
+    off_t stub_mutex_offset;
+    shm_pool_->Map(
+        (char**)&stub_mutex, sizeof(bi::interprocess_mutex), stub_mutex_offset);
 
-      bi::interprocess_condition* stub_cv;
-      off_t stub_cv_offset;
-      shm_pool_->Map(
-          (char**)&stub_cv, sizeof(bi::interprocess_condition), stub_cv_offset);
+    bi::interprocess_condition* stub_cv;
+    off_t stub_cv_offset;
+    shm_pool_->Map(
+        (char**)&stub_cv, sizeof(bi::interprocess_condition), stub_cv_offset);
 
-      stub_cond_ = stub_cv;
-      stub_mutex_ = stub_mutex;
+    stub_cond_ = stub_cv;
+    stub_mutex_ = stub_mutex;
 
-      // Parent Mutex and CV
-      bi::interprocess_mutex* parent_mutex;
-      off_t parent_mutex_offset;
-      shm_pool_->Map(
-          (char**)&parent_mutex, sizeof(bi::interprocess_mutex),
-          parent_mutex_offset);
+    // Parent Mutex and CV
+    bi::interprocess_mutex* parent_mutex;
+    off_t parent_mutex_offset;
+    shm_pool_->Map(
+        (char**)&parent_mutex, sizeof(bi::interprocess_mutex),
+        parent_mutex_offset);
 
-      bi::interprocess_condition* parent_cv;
-      off_t parent_cv_offset;
-      shm_pool_->Map(
-          (char**)&parent_cv, sizeof(bi::interprocess_condition),
-          parent_cv_offset);
+    bi::interprocess_condition* parent_cv;
+    off_t parent_cv_offset;
+    shm_pool_->Map(
+        (char**)&parent_cv, sizeof(bi::interprocess_condition),
+        parent_cv_offset);
 
-      bi::interprocess_mutex* health_mutex;
-      off_t health_mutex_offset;
-      shm_pool_->Map(
-          (char**)&health_mutex, sizeof(bi::interprocess_mutex),
-          health_mutex_offset);
+    bi::interprocess_mutex* health_mutex;
+    off_t health_mutex_offset;
+    shm_pool_->Map(
+        (char**)&health_mutex, sizeof(bi::interprocess_mutex),
+        health_mutex_offset);
 
-      health_mutex_ = health_mutex;
-      parent_mutex_ = parent_mutex;
-      parent_cond_ = parent_cv;
+    health_mutex_ = health_mutex;
+    parent_mutex_ = parent_mutex;
+    parent_cond_ = parent_cv;
 
-      IPCMessage* ipc_message;
-      off_t ipc_offset;
-      shm_pool_->Map((char**)&ipc_message, sizeof(IPCMessage), ipc_offset);
+    IPCMessage* ipc_message;
+    off_t ipc_offset;
+    shm_pool_->Map((char**)&ipc_message, sizeof(IPCMessage), ipc_offset);
 
-      off_t response_batch_offset;
-      shm_pool_->Map(
-          (char**)&response_batch_, sizeof(Response), response_batch_offset);
-      ipc_message->response_batch = response_batch_offset;
-      response_batch_->has_error = false;
-      ipc_message_ = ipc_message;
+    off_t response_batch_offset;
+    shm_pool_->Map(
+        (char**)&response_batch_, sizeof(ResponseBatch), response_batch_offset);
+    ipc_message->response_batch = response_batch_offset;
+    response_batch_->has_error = false;
+    ipc_message_ = ipc_message;
 
-      stub_lock_ = bi::scoped_lock<bi::interprocess_mutex>(*stub_mutex_);
-      NotifyParent();
+    // Started last, since the constructor throws if the shared memory can't
+    // be mapped.
+    for (int64_t i = 1; i < execute_thread_count; i++) {
+      execute_threads_.emplace_back(&Stub::ExecuteThreadLoop, this);
     }
-    catch (const PythonBackendException& pb_exception) {
-      LOG_INFO << pb_exception.what() << std::endl;
-      exit(1);
+    stub_lock_ = bi::scoped_lock<bi::interprocess_mutex>(*stub_mutex_);
+    NotifyParent();
+  }
+
+  ~Stub()
+  {
+    {
+      std::lock_guard<std::mutex> lk(execute_mu_);
+      exiting_ = true;
+    }
+    execute_cv_.notify_all();
+    for (auto& execute_thread : execute_threads_) {
+      execute_thread.join();
+    }
+  }
+
+  void ExecuteThreadLoop()
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(execute_mu_);
+        execute_cv_.wait(
+            lk, [this] { return exiting_ || !execute_tasks_.empty(); });
+        if (execute_tasks_.empty()) {
+          return;
+        }
+        task = std::move(execute_tasks_.front());
+        execute_tasks_.pop_front();
+      }
+      task();
     }
   }
 
@@ -227,6 +601,96 @@ class Stub {
     parent_cond_->notify_one();
   }
 
+  // Tell the parent process that the current request batch is done. The flag
+  // is set while holding the parent mutex, which the parent holds whenever it
+  // checks the flag, so that this notification can't be missed.
+  void NotifyBatchDone()
+  {
+    bi::scoped_lock<bi::interprocess_mutex> lk(*parent_mutex_);
+    response_batch_->batch_done = true;
+    parent_cond_->notify_one();
+  }
+
+  // Lock 'response_mu_' from a thread that holds the GIL. The GIL is released
+  // while waiting, so that the thread holding the lock can take the GIL back
+  // to finish writing its response.
+  std::unique_lock<std::mutex> LockResponses()
+  {
+    std::unique_lock<std::mutex> lk(response_mu_, std::try_to_lock);
+    if (!lk.owns_lock()) {
+      py::gil_scoped_release release;
+      lk.lock();
+    }
+    return lk;
+  }
+
+  // Append a response of request 'r' to the completion queue, so that the
+  // parent process sends it while the next responses are created. A zero
+  // 'response_offset' only sends 'flags'. 'response_mu_' must be locked.
+  void PublishResponse(uint32_t r, uint32_t flags, off_t response_offset)
+  {
+    CompletedResponse* completed;
+    off_t completed_offset;
+    shm_pool_->Map(
+        (char**)&completed, sizeof(CompletedResponse), completed_offset);
+    completed->request_index = r;
+    completed->flags = flags;
+    completed->response = response_offset;
+    completed->next = 0;
+
+    {
+      bi::scoped_lock<bi::interprocess_mutex> lk(*parent_mutex_);
+      // The responses may have been released while this one was written
+      // after them. Its memory is reused once it is released in turn.
+      if (response_batch_->responses_released) {
+        response_batch_->responses_released = false;
+        next_completed_ = &response_batch_->completed_responses;
+      }
+      __atomic_store_n(next_completed_, completed_offset, __ATOMIC_RELEASE);
+      parent_cond_->notify_one();
+    }
+    next_completed_ = &completed->next;
+    if ((flags & TRITONSERVER_RESPONSE_COMPLETE_FINAL) != 0) {
+      final_response_sent_[r] = true;
+    }
+  }
+
+  // Allocate the next responses from the shared memory of the sent ones if
+  // the parent process has released them. 'response_mu_' must be locked.
+  void ReuseReleasedResponses()
+  {
+    bi::scoped_lock<bi::interprocess_mutex> lk(*parent_mutex_);
+    if (response_batch_->responses_released) {
+      response_batch_->responses_released = false;
+      next_completed_ = &response_batch_->completed_responses;
+      shm_pool_->SetOffset(responses_offset_);
+    }
+  }
+
+  // Write 'response' for request 'r' to the shared memory and publish it.
+  // 'response' can be None to only send 'flags'.
+  void SendResponse(uint32_t r, py::handle response, uint32_t flags)
+  {
+    std::unique_lock<std::mutex> lk = LockResponses();
+    ReuseReleasedResponses();
+    off_t response_offset = 0;
+    if (!response.is_none()) {
+      Response* response_shm;
+      shm_pool_->Map(
+          (char**)&response_shm, sizeof(Response), response_offset);
+      try {
+        ProcessResponse(
+            response_shm, response_batch_, response, serialize_bytes_,
+            requested_output_names_[r]);
+      }
+      catch (const PythonBackendException& pb_exception) {
+        LOG_EXCEPTION(pb_exception);
+        SetErrorForResponse(response_shm, pb_exception.what());
+      }
+    }
+    PublishResponse(r, flags, response_offset);
+  }
+
   bool& Health() { return ipc_message_->health; }
 
   std::unique_ptr<SharedMemory>& GetSharedMemory() { return shm_pool_; }
@@ -261,7 +725,8 @@ class Stub {
 
   void ProcessResponse(
       Response* response_shm, ResponseBatch* response_batch,
-      py::handle response, py::object& serialize_bytes)
+      py::handle response, py::object& serialize_bytes,
+      const std::unordered_map<std::string, off_t>& requested_output_names)
   {
     // Initialize has_error to false
     response_shm->has_error = false;
@@ -278,205 +743,346 @@ class Stub {
       return;
     }
 
-    py::list output_tensors = response.attr("output_tensors")();
-    size_t output_tensor_length = py::len(output_tensors);
+    // The outputs that were not requested are dropped before they are
+    // serialized or copied to the shared memory.
+    std::vector<OutputTensor> outputs;
+    for (auto& output_tensor : response.attr("output_tensors")()) {
+      std::string output_name = py::str(output_tensor.attr("name")());
+      auto requested_output = requested_output_names.find(output_name);
+      if (requested_output == requested_output_names.end()) {
+        continue;
+      }
+
+      outputs.emplace_back();
+      OutputTensor& output = outputs.back();
+      output.name = requested_output->second;
+      output.item_size = 0;
+      output.contiguous = true;
+
+      py::object dlpack_tensor = output_tensor.attr("dlpack_tensor")();
+      if (!dlpack_tensor.is_none()) {
+        // Tensors created from DLPack are copied from the producer's buffer
+        // directly, without creating a numpy array.
+        DLManagedTensor* managed_tensor;
+        output.owner = ConsumeDLPack(dlpack_tensor, &managed_tensor);
+        const DLTensor& dl_tensor = managed_tensor->dl_tensor;
+        if (dl_tensor.device.device_type != kDLCPU &&
+            dl_tensor.device.device_type != kDLCUDAHost) {
+          throw PythonBackendException(
+              "Output tensor '" + output_name + "' must be in the CPU memory.");
+        }
+        output.dtype = DLDataTypeToTriton(dl_tensor.dtype);
+        if (output.dtype == TRITONSERVER_TYPE_INVALID) {
+          throw PythonBackendException(
+              "Output tensor '" + output_name +
+              "' has a DLPack data type that is not supported.");
+        }
+
+        output.item_size = dl_tensor.dtype.bits / 8;
+        output.data_ptr =
+            static_cast<char*>(dl_tensor.data) + dl_tensor.byte_offset;
+        output.shape.assign(dl_tensor.shape, dl_tensor.shape + dl_tensor.ndim);
+        output.strides.resize(dl_tensor.ndim);
+        output.byte_size = output.item_size;
+        for (int i = dl_tensor.ndim - 1; i >= 0; i--) {
+          output.strides[i] = (dl_tensor.strides == nullptr)
+                                  ? output.byte_size
+                                  : dl_tensor.strides[i] * output.item_size;
+          if (output.shape[i] != 1 && output.strides[i] != output.byte_size) {
+            output.contiguous = false;
+          }
+          output.byte_size *= output.shape[i];
+        }
+      } else {
+        py::array numpy_array = output_tensor.attr("as_numpy")();
+        py::int_ dtype = output_tensor.attr("triton_dtype")();
+        int dtype_triton_int = dtype;
+        output.dtype = static_cast<TRITONSERVER_DataType>(dtype_triton_int);
+        output.shape.assign(
+            numpy_array.shape(), numpy_array.shape() + numpy_array.ndim());
+
+        // Custom handling for type bytes.
+        if (output.dtype == TRITONSERVER_TYPE_BYTES) {
+          py::object serialized_bytes_or_none = serialize_bytes(numpy_array);
+          if (serialize_bytes.is_none()) {
+            const char* err_message =
+                "An error happened during serialization.";
+            LOG_INFO << err_message;
+            SetErrorForResponse(response_shm, err_message);
+            return;
+          }
+
+          output.owner = serialized_bytes_or_none;
+          output.data_ptr = PyBytes_AsString(output.owner.ptr());
+          output.byte_size = PyBytes_Size(output.owner.ptr());
+        } else {
+          output.owner = numpy_array;
+          output.data_ptr =
+              static_cast<char*>(const_cast<void*>(numpy_array.data()));
+          output.byte_size = numpy_array.nbytes();
+          output.item_size = numpy_array.itemsize();
+          output.strides.assign(
+              numpy_array.strides(),
+              numpy_array.strides() + numpy_array.ndim());
+          output.contiguous = (numpy_array.flags() & py::array::c_style) != 0;
+        }
+      }
+    }
 
-    size_t j = 0;
+    // The outputs are written to the shared memory without holding the GIL,
+    // so that the other Python threads can run during the copies. 'outputs'
+    // keeps the Python objects that own the data alive. 'response_mu_' stays
+    // locked, which is safe since it is only waited for without the GIL.
+    py::gil_scoped_release release;
     Tensor* output_tensors_shm;
     off_t output_tensors_offset;
     shm_pool_->Map(
-        (char**)&output_tensors_shm, sizeof(Tensor) * output_tensor_length,
+        (char**)&output_tensors_shm, sizeof(Tensor) * outputs.size(),
         output_tensors_offset);
     response_shm->outputs = output_tensors_offset;
-    response_shm->outputs_size = output_tensor_length;
+    response_shm->outputs_size = outputs.size();
 
-    for (auto& output_tensor : output_tensors) {
+    const TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    const int memory_type_id = 0;
+    for (size_t j = 0; j < outputs.size(); j++) {
+      const OutputTensor& output = outputs[j];
       Tensor* output_tensor_shm = &output_tensors_shm[j];
-      py::str name = output_tensor.attr("name")();
-      std::string output_name = name;
-
-      py::array numpy_array = output_tensor.attr("as_numpy")();
-      py::int_ dtype = output_tensor.attr("triton_dtype")();
-      py::buffer_info buffer = numpy_array.request();
-
-      int dtype_triton_int = dtype;
-      TRITONSERVER_DataType dtype_triton =
-          static_cast<TRITONSERVER_DataType>(dtype_triton_int);
+      size_t dims_count = output.shape.size();
+      std::vector<int64_t> dims(output.shape.begin(), output.shape.end());
 
+      // The name of the output is the same string as the requested output
+      // name.
       char* data_in_shm;
-      char* data_ptr;
-      const TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
-      const int memory_type_id = 0;
-
-      size_t dims_count = numpy_array.ndim();
-      int64_t dims[dims_count];
-      ssize_t byte_size;
-
-      // Custom handling for type bytes.
-      if (dtype_triton == TRITONSERVER_TYPE_BYTES) {
-        py::object serialized_bytes_or_none = serialize_bytes(numpy_array);
-        if (serialize_bytes.is_none()) {
-          const char* err_message = "An error happened during serialization.";
-          LOG_INFO << err_message;
-          SetErrorForResponse(response_shm, err_message);
-          return;
-        }
+      SaveRawDataToSharedMemory(
+          shm_pool_, output_tensor_shm->raw_data, data_in_shm, memory_type,
+          memory_type_id, output.byte_size);
+      output_tensor_shm->name = output.name;
+      output_tensor_shm->dtype = output.dtype;
+      SaveTensorDimsToSharedMemory(
+          shm_pool_, output_tensor_shm, dims.data(), dims_count);
 
-        py::bytes serialized_bytes = serialized_bytes_or_none;
-        data_ptr = PyBytes_AsString(serialized_bytes.ptr());
-        byte_size = PyBytes_Size(serialized_bytes.ptr());
+      // TODO: We can remove this memcpy if the numpy object
+      // is already in shared memory.
+      if (output.contiguous) {
+        copy_engine_->Copy(
+            data_in_shm, output.data_ptr, output.byte_size,
+            false /* non_temporal */);
       } else {
-        data_ptr = static_cast<char*>(buffer.ptr);
-        byte_size = numpy_array.nbytes();
+        // Transposed or sliced arrays are gathered directly into the shared
+        // memory.
+        StridedCopy(
+            output.data_ptr, output.shape.data(), output.strides.data(),
+            dims_count, output.item_size, data_in_shm);
       }
+    }
+  }
 
-      const ssize_t* numpy_shape = numpy_array.shape();
-      for (size_t i = 0; i < dims_count; i++) {
-        dims[i] = numpy_shape[i];
-      }
+  // Get the numpy data type used to wrap the tensors of type 'dtype'.
+  py::dtype& NumpyDtype(TRITONSERVER_DataType dtype)
+  {
+    auto it = numpy_dtypes_.find(dtype);
+    if (it != numpy_dtypes_.end()) {
+      return it->second;
+    }
 
-      SaveTensorToSharedMemory(
-          shm_pool_, output_tensor_shm, data_in_shm, memory_type,
-          memory_type_id, byte_size, output_name.c_str(), dims, dims_count,
-          dtype_triton);
+    py::dtype dtype_numpy;
+    switch (dtype) {
+      case TRITONSERVER_TYPE_BOOL:
+        dtype_numpy = py::dtype(py::format_descriptor<bool>::format());
+        break;
+      case TRITONSERVER_TYPE_UINT8:
+        dtype_numpy = py::dtype(py::format_descriptor<uint8_t>::format());
+        break;
+      case TRITONSERVER_TYPE_UINT16:
+        dtype_numpy = py::dtype(py::format_descriptor<uint16_t>::format());
+        break;
+      case TRITONSERVER_TYPE_UINT32:
+        dtype_numpy = py::dtype(py::format_descriptor<uint32_t>::format());
+        break;
+      case TRITONSERVER_TYPE_UINT64:
+        dtype_numpy = py::dtype(py::format_descriptor<uint64_t>::format());
+        break;
+      case TRITONSERVER_TYPE_INT8:
+        dtype_numpy = py::dtype(py::format_descriptor<int8_t>::format());
+        break;
+      case TRITONSERVER_TYPE_INT16:
+        dtype_numpy = py::dtype(py::format_descriptor<int16_t>::format());
+        break;
+      case TRITONSERVER_TYPE_INT32:
+        dtype_numpy = py::dtype(py::format_descriptor<int32_t>::format());
+        break;
+      case TRITONSERVER_TYPE_INT64:
+        dtype_numpy = py::dtype(py::format_descriptor<int64_t>::format());
+        break;
+      case TRITONSERVER_TYPE_FP16:
+        // Will be reinterpreted in the python code.
+        dtype_numpy = py::dtype(py::format_descriptor<uint16_t>::format());
+        break;
+      case TRITONSERVER_TYPE_FP32:
+        dtype_numpy = py::dtype(py::format_descriptor<float>::format());
+        break;
+      case TRITONSERVER_TYPE_FP64:
+        dtype_numpy = py::dtype(py::format_descriptor<double>::format());
+        break;
+      case TRITONSERVER_TYPE_BYTES:
+        // Will be reinterpreted in the python code.
+        dtype_numpy = py::dtype(py::format_descriptor<uint8_t>::format());
+        break;
+      default:
+        break;
+    }
 
-      // TODO: We can remove this memcpy if the numpy object
-      // is already in shared memory.
-      std::copy(data_ptr, data_ptr + byte_size, data_in_shm);
-      j += 1;
+    return numpy_dtypes_.emplace(dtype, dtype_numpy).first->second;
+  }
+
+  // Get the Python name of a tensor from the offset of its name.
+  py::object LoadTensorName(off_t name_offset)
+  {
+    auto it = tensor_names_.find(name_offset);
+    if (it != tensor_names_.end()) {
+      return it->second;
+    }
+
+    char* name = nullptr;
+    LoadStringFromSharedMemory(shm_pool_, name_offset, name);
+    py::object py_name = py::str(name);
+    if (name_offset < request_batch_offset_) {
+      tensor_names_.emplace(name_offset, py_name);
     }
+
+    return py_name;
   }
 
-  void ProcessRequest(
-      Request* request, ResponseBatch* response_batch,
-      py::object& infer_request, py::object& PyRequest, py::object& PyTensor,
-      py::object& deserialize_bytes)
+  void MapTensor(Tensor* tensor, MappedTensor& mapped_tensor)
+  {
+    RawData* raw_data;
+    shm_pool_->MapOffset(
+        (char**)&raw_data, sizeof(RawData), tensor->raw_data);
+    shm_pool_->MapOffset(
+        (char**)&mapped_tensor.data, raw_data->byte_size,
+        raw_data->memory_ptr);
+
+    int64_t* dims;
+    shm_pool_->MapOffset(
+        (char**)&dims, sizeof(int64_t) * tensor->dims_count, tensor->dims);
+
+    mapped_tensor.name = tensor->name;
+    mapped_tensor.dtype = tensor->dtype;
+    mapped_tensor.byte_size = raw_data->byte_size;
+    mapped_tensor.shape.assign(dims, dims + tensor->dims_count);
+  }
+
+  void MapRequest(Request* request, MappedRequest& mapped_request)
   {
-    char* id = nullptr;
-    LoadStringFromSharedMemory(shm_pool_, request->id, id);
+    LoadStringFromSharedMemory(shm_pool_, request->id, mapped_request.id);
+    mapped_request.correlation_id = request->correlation_id;
 
     uint32_t requested_input_count = request->requested_input_count;
     Tensor* input_tensors;
     shm_pool_->MapOffset(
         (char**)&input_tensors, sizeof(Tensor) * requested_input_count,
         request->inputs);
-
-    py::list py_input_tensors;
+    mapped_request.inputs.resize(requested_input_count);
     for (size_t input_idx = 0; input_idx < requested_input_count; ++input_idx) {
-      Tensor* input_tensor = &input_tensors[input_idx];
+      MapTensor(&input_tensors[input_idx], mapped_request.inputs[input_idx]);
+    }
 
-      char* name = nullptr;
-      LoadStringFromSharedMemory(shm_pool_, input_tensor->name, name);
+    uint32_t requested_output_count = request->requested_output_count;
+    shm_pool_->MapOffset(
+        (char**)&mapped_request.requested_output_name_offsets,
+        sizeof(off_t) * requested_output_count,
+        request->requested_output_names);
+    mapped_request.requested_output_names.resize(requested_output_count);
+    for (size_t output_idx = 0; output_idx < requested_output_count;
+         ++output_idx) {
+      LoadStringFromSharedMemory(
+          shm_pool_, mapped_request.requested_output_name_offsets[output_idx],
+          mapped_request.requested_output_names[output_idx]);
+    }
+  }
 
-      RawData* raw_data;
-      shm_pool_->MapOffset(
-          (char**)&raw_data, sizeof(RawData), input_tensor->raw_data);
+  // Map the requests and the batch inputs of 'request_batch'. Doesn't need
+  // the GIL.
+  void MapRequestBatch(
+      RequestBatch* request_batch, std::vector<MappedRequest>& mapped_requests,
+      std::vector<MappedTensor>& mapped_batch_inputs)
+  {
+    Request* requests;
+    shm_pool_->MapOffset(
+        (char**)&requests, sizeof(Request) * request_batch->batch_size,
+        request_batch->requests);
+    mapped_requests.resize(request_batch->batch_size);
+    for (size_t i = 0; i < request_batch->batch_size; i++) {
+      MapRequest(&requests[i], mapped_requests[i]);
+    }
 
-      char* data;
-      shm_pool_->MapOffset(
-          (char**)&data, raw_data->byte_size, raw_data->memory_ptr);
+    Tensor* batch_input_tensors;
+    shm_pool_->MapOffset(
+        (char**)&batch_input_tensors,
+        sizeof(Tensor) * request_batch->batch_input_count,
+        request_batch->batch_inputs);
+    mapped_batch_inputs.resize(request_batch->batch_input_count);
+    for (size_t j = 0; j < request_batch->batch_input_count; j++) {
+      MapTensor(&batch_input_tensors[j], mapped_batch_inputs[j]);
+    }
+  }
 
-      size_t dims_count = input_tensor->dims_count;
+  // Create a Python Tensor object that wraps the data of 'tensor' in the
+  // shared memory.
+  py::object LoadPythonTensor(
+      const MappedTensor& tensor, py::object& PyTensor,
+      py::object& deserialize_bytes)
+  {
+    py::object name = LoadTensorName(tensor.name);
+    py::dtype dtype_numpy = NumpyDtype(tensor.dtype);
 
-      int64_t* dims;
-      shm_pool_->MapOffset(
-          (char**)&dims, sizeof(int64_t) * dims_count, input_tensor->dims);
-
-      TRITONSERVER_DataType dtype = input_tensor->dtype;
-      std::vector<int64_t> shape{dims, dims + dims_count};
-      py::dtype dtype_numpy;
-      switch (dtype) {
-        case TRITONSERVER_TYPE_BOOL:
-          dtype_numpy = py::dtype(py::format_descriptor<bool>::format());
-          break;
-        case TRITONSERVER_TYPE_UINT8:
-          dtype_numpy = py::dtype(py::format_descriptor<uint8_t>::format());
-          break;
-        case TRITONSERVER_TYPE_UINT16:
-          dtype_numpy = py::dtype(py::format_descriptor<uint16_t>::format());
-          break;
-        case TRITONSERVER_TYPE_UINT32:
-          dtype_numpy = py::dtype(py::format_descriptor<uint32_t>::format());
-          break;
-        case TRITONSERVER_TYPE_UINT64:
-          dtype_numpy = py::dtype(py::format_descriptor<uint64_t>::format());
-          break;
-        case TRITONSERVER_TYPE_INT8:
-          dtype_numpy = py::dtype(py::format_descriptor<int8_t>::format());
-          break;
-        case TRITONSERVER_TYPE_INT16:
-          dtype_numpy = py::dtype(py::format_descriptor<int16_t>::format());
-          break;
-        case TRITONSERVER_TYPE_INT32:
-          dtype_numpy = py::dtype(py::format_descriptor<int32_t>::format());
-          break;
-        case TRITONSERVER_TYPE_INT64:
-          dtype_numpy = py::dtype(py::format_descriptor<int64_t>::format());
-          break;
-        case TRITONSERVER_TYPE_FP16:
-          // Will be reinterpreted in the python code.
-          dtype_numpy = py::dtype(py::format_descriptor<uint16_t>::format());
-          break;
-        case TRITONSERVER_TYPE_FP32:
-          dtype_numpy = py::dtype(py::format_descriptor<float>::format());
-          break;
-        case TRITONSERVER_TYPE_FP64:
-          dtype_numpy = py::dtype(py::format_descriptor<double>::format());
-          break;
-        case TRITONSERVER_TYPE_BYTES:
-          // Will be reinterpreted in the python code.
-          dtype_numpy = py::dtype(py::format_descriptor<uint8_t>::format());
-          break;
-        default:
-          break;
-      }
+    try {
+      // Custom handling for bytes
+      if (tensor.dtype == TRITONSERVER_TYPE_BYTES) {
+        py::array numpy_array(
+            dtype_numpy, {tensor.byte_size}, (void*)tensor.data);
+        py::list dims = py::cast(tensor.shape);
 
-      try {
-        // Custom handling for bytes
-        if (dtype == TRITONSERVER_TYPE_BYTES) {
-          py::array numpy_array(
-              dtype_numpy, {raw_data->byte_size}, (void*)data);
-          py::list dims = py::cast(shape);
-
-          py::object deserialized =
-              deserialize_bytes(numpy_array).attr("reshape")(dims);
-
-          py::object py_input_tensor =
-              PyTensor(name, deserialized, static_cast<int>(dtype));
-          py_input_tensors.append(py_input_tensor);
-        } else {
-          py::array numpy_array(dtype_numpy, shape, (void*)data);
-          py::object py_input_tensor =
-              PyTensor(name, numpy_array, static_cast<int>(dtype));
-          py_input_tensors.append(py_input_tensor);
-        }
-      }
-      catch (const py::error_already_set& e) {
-        LOG_INFO << e.what();
-        throw PythonBackendException(e.what());
-        return;
+        py::object deserialized =
+            deserialize_bytes(numpy_array).attr("reshape")(dims);
+
+        return PyTensor(name, deserialized, static_cast<int>(tensor.dtype));
+      } else {
+        py::array numpy_array(dtype_numpy, tensor.shape, (void*)tensor.data);
+        return PyTensor(name, numpy_array, static_cast<int>(tensor.dtype));
       }
     }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+      throw PythonBackendException(e.what());
+    }
+  }
 
-    py::list py_requested_output_names;
-
-    uint32_t requested_output_count = request->requested_output_count;
-    off_t* output_names;
-    shm_pool_->MapOffset(
-        (char**)&output_names, sizeof(off_t) * requested_output_count,
-        request->requested_output_names);
+  void ProcessRequest(
+      const MappedRequest& request, py::object& infer_request,
+      py::object& PyRequest, py::object& PyTensor,
+      py::object& deserialize_bytes, py::object& py_batch_inputs,
+      py::object& response_sender,
+      std::unordered_map<std::string, off_t>& requested_output_names)
+  {
+    py::list py_input_tensors;
+    for (const MappedTensor& input_tensor : request.inputs) {
+      py_input_tensors.append(
+          LoadPythonTensor(input_tensor, PyTensor, deserialize_bytes));
+    }
 
-    for (size_t output_idx = 0; output_idx < requested_output_count;
-         ++output_idx) {
-      char* output_name = nullptr;
-      LoadStringFromSharedMemory(
-          shm_pool_, output_names[output_idx], output_name);
+    py::list py_requested_output_names;
+    for (size_t output_idx = 0;
+         output_idx < request.requested_output_names.size(); ++output_idx) {
+      char* output_name = request.requested_output_names[output_idx];
       py_requested_output_names.append(output_name);
+      requested_output_names.emplace(
+          output_name, request.requested_output_name_offsets[output_idx]);
     }
 
     infer_request = PyRequest(
-        py_input_tensors, id, request->correlation_id,
-        py_requested_output_names);
+        py_input_tensors, request.id, request.correlation_id,
+        py_requested_output_names, py_batch_inputs, response_sender);
   }
 
   void SetResponseFromException(const PythonBackendException& pb_exception)
@@ -489,44 +1095,91 @@ class Stub {
     // Reset the value for has_error
     response_batch_->has_error = false;
 
-    RequestBatch* request_batch;
+    // The request batch is mapped without holding the GIL, including the
+    // remapping of the shared memory region after the parent process has grown
+    // it, so that the other Python threads can run meanwhile.
+    uint32_t batch_size = 0;
+    off_t reload_offset = 0;
+    std::vector<MappedRequest> mapped_requests;
+    std::vector<MappedTensor> mapped_batch_inputs;
     try {
+      py::gil_scoped_release release;
+      RequestBatch* request_batch;
       shm_pool_->MapOffset(
           (char**)&request_batch, sizeof(RequestBatch),
           ipc_message_->request_batch);
+      batch_size = request_batch->batch_size;
+      if (batch_size != 0) {
+        MapRequestBatch(request_batch, mapped_requests, mapped_batch_inputs);
+      } else {
+        reload_offset = request_batch->reload;
+      }
     }
     catch (const PythonBackendException& pb_exception) {
       LOG_EXCEPTION(pb_exception);
       SetResponseFromException(pb_exception);
       return 0;
     }
-    uint32_t batch_size = request_batch->batch_size;
+    request_batch_offset_ = ipc_message_->request_batch;
 
-    // An empty batch size indicates termination
+    // An empty batch size indicates termination, unless the parent asks for
+    // the model to be reloaded.
     if (batch_size == 0) {
-      return 1;
-    }
-
-    Request* requests;
-    try {
-      shm_pool_->MapOffset(
-          (char**)&requests, sizeof(Request) * batch_size,
-          request_batch->requests);
-    }
-    catch (const PythonBackendException& pb_exception) {
-      LOG_EXCEPTION(pb_exception);
-      SetResponseFromException(pb_exception);
+      if (reload_offset == 0) {
+        return 1;
+      }
+      Reload(reload_offset);
       return 0;
     }
 
+    // Tensors shared by all the requests in the batch, i.e. the packed inputs
+    // and the batch inputs generated by the backend. They are only loaded
+    // when the model first asks for them, so that the models that don't use
+    // them don't pay for e.g. deserializing BYTES inputs twice.
+    auto batch_inputs = std::make_shared<LazyBatchInputs>();
+    batch_inputs->mapped_tensors = std::move(mapped_batch_inputs);
+    batch_inputs->loaded = false;
+    py::object py_batch_inputs = py::cpp_function([this, batch_inputs]() {
+      if (!batch_inputs->loaded) {
+        for (const MappedTensor& batch_input : batch_inputs->mapped_tensors) {
+          py::object py_batch_input =
+              LoadPythonTensor(batch_input, PyTensor_, deserialize_bytes_);
+          batch_inputs->tensors[py_batch_input.attr("name")()] =
+              py_batch_input;
+        }
+        batch_inputs->loaded = true;
+      }
+      return batch_inputs->tensors;
+    });
+
+    // Responses are allocated in the shared memory as they are sent, after the
+    // requests of the batch.
+    requested_output_names_.assign(batch_size, {});
+    final_response_sent_.assign(batch_size, false);
+    next_completed_ = &response_batch_->completed_responses;
+    responses_offset_ = shm_pool_->Offset();
+    response_batch_->batch_size = batch_size;
+
     py::list py_request_list;
     for (size_t i = 0; i < batch_size; i++) {
-      Request* request = &requests[i];
       py::object infer_request;
+      py::object response_sender = py::none();
+      if (decoupled_) {
+        response_sender = PyResponseSender_(py::cpp_function(
+            [this, i](py::object response, uint32_t flags) {
+              if (!sending_responses_) {
+                throw PythonBackendException(
+                    "Response senders can only be used until `execute` "
+                    "returns.");
+              }
+              SendResponse(i, response, flags);
+            }));
+      }
       try {
         ProcessRequest(
-            request, response_batch_, infer_request, PyRequest_, PyTensor_,
-            deserialize_bytes_);
+            mapped_requests[i], infer_request, PyRequest_, PyTensor_,
+            deserialize_bytes_, py_batch_inputs, response_sender,
+            requested_output_names_[i]);
       }
       catch (const PythonBackendException& pb_exception) {
         LOG_EXCEPTION(pb_exception);
@@ -536,8 +1189,6 @@ class Stub {
       py_request_list.append(infer_request);
     }
 
-    py::list responses;
-
     if (!py::hasattr(model_instance_, "execute")) {
       std::string message = "Python model " + model_path_ +
                             " does not implement `execute` method.";
@@ -547,52 +1198,270 @@ class Stub {
       return 0;
     }
 
-    // Execute Response
-    try {
-      responses = model_instance_.attr("execute")(py_request_list);
+    sending_responses_ = true;
+    std::string error;
+    if (execute_threads_.empty() || batch_size == 1) {
+      error = ExecuteRequests(py_request_list, 0);
+    } else {
+      error = ExecuteConcurrently(py_request_list, batch_size);
     }
-    catch (const py::error_already_set& e) {
-      LOG_INFO << e.what();
-      SetErrorForResponseBatch(e.what());
+    sending_responses_ = false;
 
-      return 0;
+    if (!error.empty()) {
+      SetErrorForResponseBatch(error.c_str());
     }
 
-    Response* responses_shm;
-    off_t responses_shm_offset;
-    size_t response_size = py::len(responses);
+    return 0;
+  }
 
-    try {
-      shm_pool_->Map(
-          (char**)&responses_shm, sizeof(Response) * response_size,
-          responses_shm_offset);
-    }
+  // Split the batch into one sub-batch per execute thread and call 'execute'
+  // for all of them at the same time. The calling thread executes the first
+  // sub-batch. The sub-batches run in parallel while the model releases the
+  // GIL, e.g. in native code. Returns the error of the first sub-batch that
+  // failed, or an empty string.
+  std::string ExecuteConcurrently(
+      py::list& py_request_list, uint32_t batch_size)
+  {
+    const uint32_t sub_batch_count =
+        std::min<uint32_t>(execute_threads_.size() + 1, batch_size);
+    std::vector<py::list> sub_batches(sub_batch_count);
+    std::vector<uint32_t> begins(sub_batch_count);
+    std::vector<std::string> errors(sub_batch_count);
+    for (uint32_t s = 0; s < sub_batch_count; s++) {
+      begins[s] = (uint64_t)batch_size * s / sub_batch_count;
+      const uint32_t end = (uint64_t)batch_size * (s + 1) / sub_batch_count;
+      for (uint32_t r = begins[s]; r < end; r++) {
+        sub_batches[s].append(py_request_list[r]);
+      }
+    }
+
+    std::mutex mu;
+    std::condition_variable cv;
+    uint32_t pending = sub_batch_count - 1;
+    {
+      std::lock_guard<std::mutex> lk(execute_mu_);
+      for (uint32_t s = 1; s < sub_batch_count; s++) {
+        execute_tasks_.emplace_back([this, s, &sub_batches, &begins, &errors,
+                                     &mu, &cv, &pending] {
+          {
+            py::gil_scoped_acquire gil;
+            errors[s] = ExecuteRequests(sub_batches[s], begins[s]);
+          }
+          std::lock_guard<std::mutex> lk(mu);
+          if (--pending == 0) {
+            cv.notify_one();
+          }
+        });
+      }
+    }
+    execute_cv_.notify_all();
+
+    errors[0] = ExecuteRequests(sub_batches[0], begins[0]);
+    {
+      py::gil_scoped_release release;
+      std::unique_lock<std::mutex> lk(mu);
+      cv.wait(lk, [&pending] { return pending == 0; });
+    }
+
+    for (const std::string& error : errors) {
+      if (!error.empty()) {
+        return error;
+      }
+    }
+    return std::string();
+  }
+
+  // Call 'execute' for 'py_requests', which are the requests of the batch
+  // starting at index 'begin'. Returns the error of the whole sub-batch, or an
+  // empty string.
+  std::string ExecuteRequests(py::list& py_requests, uint32_t begin)
+  {
+    if (decoupled_) {
+      return ExecuteDecoupled(py_requests, begin);
+    }
+
+    // 'execute' either returns the list of responses, or yields each response
+    // as soon as it is ready. A response goes to the first request that does
+    // not have one yet, unless it is yielded as a (request, response) pair.
+    const size_t request_count = py::len(py_requests);
+    std::vector<bool> completed(request_count, false);
+    size_t completed_count = 0;
+    size_t next_request = 0;
+    try {
+      py::object responses =
+          RunAsync(model_instance_.attr("execute")(py_requests));
+      if (py::isinstance<py::list>(responses) && (py::len(responses) != 0)) {
+        size_t awaitable_count = 0;
+        for (auto item : responses) {
+          if (py::bool_(is_awaitable_(item))) {
+            awaitable_count++;
+          }
+        }
+        if (awaitable_count == py::len(responses)) {
+          return CompleteAwaitables(responses, begin, request_count);
+        }
+        if (awaitable_count != 0) {
+          std::string message =
+              "The list returned by 'execute' must contain either only "
+              "awaitables or only InferenceResponse objects.";
+          LOG_INFO << message;
+          return message;
+        }
+      }
+
+      for (auto item : responses) {
+        size_t index = request_count;
+        py::object response;
+        if (py::isinstance<py::tuple>(item)) {
+          py::tuple request_response = py::reinterpret_borrow<py::tuple>(item);
+          for (size_t r = 0; r < request_count; r++) {
+            if (py_requests[r].is(request_response[0])) {
+              index = r;
+              break;
+            }
+          }
+          response = request_response[1];
+        } else {
+          while ((next_request < request_count) && completed[next_request]) {
+            next_request++;
+          }
+          index = next_request;
+          response = py::reinterpret_borrow<py::object>(item);
+        }
+
+        if ((index == request_count) || completed[index]) {
+          std::string message =
+              "Number of InferenceResponse objects do not match the number of "
+              "requests. Every request must have exactly one response.";
+          LOG_INFO << message;
+          return message;
+        }
+
+        SendResponse(
+            begin + index, response, TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+        completed[index] = true;
+        completed_count++;
+      }
+    }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+      return e.what();
+    }
     catch (const PythonBackendException& pb_exception) {
       LOG_EXCEPTION(pb_exception);
-      SetResponseFromException(pb_exception);
-      return 0;
+      return pb_exception.what();
     }
-    response_batch_->responses = responses_shm_offset;
-    response_batch_->batch_size = response_size;
 
-    size_t i = 0;
-    for (auto& response : responses) {
-      Response* response_shm = &responses_shm[i];
-      try {
-        ProcessResponse(
-            response_shm, response_batch_, response, serialize_bytes_);
+    if (completed_count != request_count) {
+      std::string message =
+          "Number of InferenceResponse objects do not match the number of "
+          "requests. Expected " +
+          std::to_string(request_count) + ", got " +
+          std::to_string(completed_count) + ".";
+      LOG_INFO << message;
+      return message;
+    }
+
+    return std::string();
+  }
+
+  // Get the event loop of the calling thread. The GIL must be held.
+  py::object& EventLoop()
+  {
+    py::object& event_loop = event_loops_[std::this_thread::get_id()];
+    if (!event_loop) {
+      py::module asyncio = py::module::import("asyncio");
+      event_loop = asyncio.attr("new_event_loop")();
+      asyncio.attr("set_event_loop")(event_loop);
+    }
+    return event_loop;
+  }
+
+  // Run the result of an `async` execute on the event loop of the calling
+  // thread. Coroutines are run until they complete, and asynchronous
+  // generators are iterated one response at a time.
+  py::object RunAsync(py::object result)
+  {
+    py::bool_ is_coroutine = is_coroutine_(result);
+    if (is_coroutine) {
+      return EventLoop().attr("run_until_complete")(result);
+    }
+    py::bool_ is_async_generator = is_async_generator_(result);
+    if (is_async_generator) {
+      return iterate_async_generator_(EventLoop(), result);
+    }
+    return result;
+  }
+
+  // Await the awaitables returned by 'execute', one for each request starting
+  // at index 'begin', concurrently on the event loop of the calling thread.
+  // Each response is sent as soon as it is ready.
+  std::string CompleteAwaitables(
+      py::object awaitables, uint32_t begin, size_t request_count)
+  {
+    if (py::len(awaitables) != request_count) {
+      std::string message =
+          "Number of awaitables returned by `execute` do not match the number "
+          "of requests. Expected " +
+          std::to_string(request_count) + ", got " +
+          std::to_string(py::len(awaitables)) + ".";
+      LOG_INFO << message;
+      return message;
+    }
+
+    EventLoop().attr("run_until_complete")(complete_responses_(
+        awaitables,
+        py::cpp_function([this, begin](uint32_t index, py::object response) {
+          SendResponse(
+              begin + index, response, TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+        })));
+    return std::string();
+  }
+
+  // Decoupled models send the responses of each request through its response
+  // sender while 'execute' runs, so 'execute' must return None. The requests
+  // that are not complete when 'execute' returns are completed here.
+  std::string ExecuteDecoupled(py::list& py_requests, uint32_t begin)
+  {
+    try {
+      py::object result =
+          RunAsync(model_instance_.attr("execute")(py_requests));
+      if (!result.is_none()) {
+        std::string message =
+            "Python model " + model_path_ +
+            " is decoupled, `execute` must send the responses with the "
+            "response senders of the requests and return None.";
+        LOG_INFO << message;
+        return message;
       }
-      catch (const PythonBackendException& pb_exception) {
-        LOG_EXCEPTION(pb_exception);
-        SetErrorForResponse(response_shm, pb_exception.what());
+
+      std::unique_lock<std::mutex> lk = LockResponses();
+      const uint32_t end = begin + py::len(py_requests);
+      for (uint32_t r = begin; r < end; r++) {
+        if (!final_response_sent_[r]) {
+          PublishResponse(r, TRITONSERVER_RESPONSE_COMPLETE_FINAL, 0);
+        }
       }
-      i += 1;
+    }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+      return e.what();
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_EXCEPTION(pb_exception);
+      return pb_exception.what();
     }
 
-    return 0;
+    return std::string();
   }
 
-  void Initialize(std::string& model_version, std::string triton_install_path)
+  // Import the model and initialize it. The model is imported as the
+  // '<version>.model' module, unless 'module_name' is set, in which case it
+  // is imported from its file with this name. Returns false if the model
+  // has failed to initialize, once the parent has been notified.
+  bool Initialize(
+      std::string& model_version, std::string triton_install_path,
+      const std::string& module_name = "")
   {
     try {
       try {
@@ -609,14 +1478,35 @@ class Stub {
         sys.attr("path").attr("append")(model_path_parent_parent);
         sys.attr("path").attr("append")(python_backend_folder);
 
+        // The parent sends SIGUSR1 to log the stacks of a batch that has
+        // exceeded its time limit, before killing the stub.
+        py::module::import("faulthandler")
+            .attr("register")(SIGUSR1, py::arg("all_threads") = true);
+
         py::module python_backend_utils =
             py::module::import("triton_python_backend_utils");
 
-        py::object TritonPythonModel =
-            py::module::import((model_version + std::string(".model")).c_str())
-                .attr("TritonPythonModel");
+        py::object TritonPythonModel;
+        if (module_name.empty()) {
+          std::string model_module_name = model_version + ".model";
+          TritonPythonModel = py::module::import(model_module_name.c_str())
+                                  .attr("TritonPythonModel");
+        } else {
+          py::object module = ImportModelFile(module_name, model_path_);
+          sys.attr("modules")[module_name.c_str()] = module;
+          TritonPythonModel = module.attr("TritonPythonModel");
+        }
         PyRequest_ = python_backend_utils.attr("InferenceRequest");
         PyTensor_ = python_backend_utils.attr("Tensor");
+        PyResponseSender_ =
+            python_backend_utils.attr("InferenceResponseSender");
+        iterate_async_generator_ =
+            python_backend_utils.attr("_iterate_async_generator");
+        complete_responses_ = python_backend_utils.attr("_complete_responses");
+        py::module inspect = py::module::import("inspect");
+        is_coroutine_ = inspect.attr("iscoroutine");
+        is_async_generator_ = inspect.attr("isasyncgen");
+        is_awaitable_ = inspect.attr("isawaitable");
         deserialize_bytes_ =
             python_backend_utils.attr("deserialize_bytes_tensor");
         serialize_bytes_ = python_backend_utils.attr("serialize_byte_tensor");
@@ -624,8 +1514,13 @@ class Stub {
 
         std::unordered_map<std::string, std::string> map;
         LoadMapFromSharedMemory(shm_pool_, ipc_message_->request_batch, map);
-        py::dict model_config_params;
+        py::object model_config =
+            py::module::import("json").attr("loads")(map["model_config"]);
+        py::bool_ py_decoupled = python_backend_utils.attr(
+            "using_decoupled_model_transaction_policy")(model_config);
+        decoupled_ = py_decoupled;
 
+        py::dict model_config_params;
         for (const auto& pair : map) {
           model_config_params[pair.first.c_str()] = pair.second;
         }
@@ -640,14 +1535,90 @@ class Stub {
         SetErrorForResponseBatch(e.what());
 
         NotifyParent();
-        exit(1);
+        return false;
       }
     }
     catch (const PythonBackendException& pb_exception) {
       LOG_INFO << "Failed to initialize Python stub: " << pb_exception.what();
       NotifyParent();
-      exit(1);
+      return false;
     }
+
+    return true;
+  }
+
+  // Import the model version whose initialize arguments are saved at
+  // 'args_offset' and initialize it. The current model keeps serving the
+  // batches if the new one fails to initialize. Otherwise the new model
+  // replaces it for the next batches, and the current model is finalized.
+  void Reload(off_t args_offset)
+  {
+    try {
+      std::unordered_map<std::string, std::string> map;
+      LoadMapFromSharedMemory(shm_pool_, args_offset, map);
+      std::string model_path =
+          map["model_repository"] + "/" + map["model_version"] + "/model.py";
+      std::string module_name = map["model_version"] + ".model";
+
+      py::module python_backend_utils =
+          py::module::import("triton_python_backend_utils");
+      py::object model_config =
+          py::module::import("json").attr("loads")(map["model_config"]);
+      bool decoupled = py::bool_(python_backend_utils.attr(
+          "using_decoupled_model_transaction_policy")(model_config));
+
+      // The module is only registered once the model is initialized, so that
+      // a failed version doesn't replace the module of the current one.
+      py::object module = ImportModelFile(module_name, model_path);
+      py::object model_instance = module.attr("TritonPythonModel")();
+      py::dict model_config_params;
+      for (const auto& pair : map) {
+        model_config_params[pair.first.c_str()] = pair.second;
+      }
+      if (py::hasattr(model_instance, "initialize")) {
+        model_instance.attr("initialize")(model_config_params);
+      }
+      py::module::import("sys").attr("modules")[module_name.c_str()] = module;
+
+      py::object previous_instance = model_instance_;
+      model_instance_ = model_instance;
+      model_path_ = model_path;
+      decoupled_ = decoupled;
+
+      // The parent allocates the static tensor slots again for the new model.
+      tensor_names_.clear();
+      LOG_INFO << "Reloaded the model from " << model_path_;
+
+      if (py::hasattr(previous_instance, "finalize")) {
+        try {
+          previous_instance.attr("finalize")();
+        }
+        catch (const py::error_already_set& e) {
+          LOG_INFO << e.what();
+        }
+      }
+    }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+      SetErrorForResponseBatch(e.what());
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_EXCEPTION(pb_exception);
+      SetResponseFromException(pb_exception);
+    }
+  }
+
+  // Import the model file 'model_file' as the module 'module_name', without
+  // registering the module.
+  py::object ImportModelFile(
+      const std::string& module_name, const std::string& model_file)
+  {
+    py::module importlib_util = py::module::import("importlib.util");
+    py::object spec = importlib_util.attr("spec_from_file_location")(
+        module_name, model_file);
+    py::object module = importlib_util.attr("module_from_spec")(spec);
+    spec.attr("loader").attr("exec_module")(module);
+    return module;
   }
 
   void UpdateHealth()
@@ -656,8 +1627,39 @@ class Stub {
     ipc_message_->health = true;
   }
 
+  // Whether the parent process has asked the stub of a shared stub process
+  // to stop without finalizing the model. The stub then stops waiting for
+  // request batches.
+  bool AbortRequested()
+  {
+    bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
+    if (ipc_message_->abort) {
+      aborting_ = true;
+    }
+    return aborting_;
+  }
+
+  // Tell the parent process that the aborted stub no longer uses the shared
+  // memory, so that the region can be given to the next stub of the model.
+  void AcknowledgeAbort()
+  {
+    if (stub_lock_.owns()) {
+      stub_lock_.unlock();
+    }
+    bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
+    ipc_message_->abort = false;
+  }
+
   void Finalize()
   {
+    CopyStats copy_stats = copy_engine_->Stats();
+    if (copy_stats.copy_count != 0) {
+      LOG_INFO << "Copied " << copy_stats.byte_size << " bytes in "
+               << copy_stats.copy_count << " copies ("
+               << copy_stats.duration_ns / 1000000
+               << " ms) to the shared memory in this stub process";
+    }
+
     // Call finalize if exists.
     if (py::hasattr(model_instance_, "finalize")) {
       try {
@@ -667,10 +1669,15 @@ class Stub {
         LOG_INFO << e.what();
       }
     }
+
+    for (auto& event_loop : event_loops_) {
+      event_loop.second.attr("close")();
+    }
+    event_loops_.clear();
   }
 
   // Wait for notification from the server. Returns true if the parent process
-  // has received a SIGTERM, and false otherwise.
+  // has received a SIGTERM or has aborted the stub, and false otherwise.
   bool WaitForNotification()
   {
     boost::posix_time::ptime timeout;
@@ -678,31 +1685,106 @@ class Stub {
       timeout =
           boost::get_system_time() + boost::posix_time::milliseconds(1000);
     } while (!stub_cond_->timed_wait(stub_lock_, timeout) != 0 &&
-             !sigterm_received);
-    return sigterm_received;
+             !sigterm_received && !AbortRequested());
+    return sigterm_received || aborting_;
   }
 };
 
-extern "C" {
+//
+// FairDispatcher
+//
+// Gives the models of a shared stub process their turns to take the GIL, in
+// the order in which they have received their request batches, so that a
+// busy model can't keep the other ones from starting their batches.
+//
+class FairDispatcher {
+  std::mutex mu_;
+  std::condition_variable cv_;
+  uint64_t next_ticket_;
+  uint64_t current_ticket_;
 
-int
-main(int argc, char** argv)
+ public:
+  FairDispatcher() : next_ticket_(0), current_ticket_(0) {}
+
+  // Wait for the turn of the calling thread.
+  void Enter()
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    const uint64_t ticket = next_ticket_++;
+    cv_.wait(lock, [this, ticket] { return current_ticket_ == ticket; });
+  }
+
+  // End the turn of the calling thread.
+  void Leave()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      current_ticket_++;
+    }
+    cv_.notify_all();
+  }
+};
+
+//
+// ModelTurn
+//
+// Takes the GIL for a model of a shared stub process in its turn, and holds
+// the GIL while it exists. The turn ends as soon as the GIL is taken, so
+// that the next model waits for the GIL too. The models then share the GIL
+// like any Python threads: a model that releases it, e.g. in native code or
+// I/O, lets the other ones run, and the interpreter switches between the
+// ones that run Python code every switch interval. Does nothing if
+// 'dispatcher' is nullptr, i.e. the stub process only serves one model, from
+// its main thread, which always holds the GIL.
+//
+class ModelTurn {
+  FairDispatcher* dispatcher_;
+  std::unique_ptr<py::gil_scoped_acquire> gil_;
+
+ public:
+  explicit ModelTurn(FairDispatcher* dispatcher) : dispatcher_(dispatcher)
+  {
+    if (dispatcher_ != nullptr) {
+      dispatcher_->Enter();
+      gil_ = std::make_unique<py::gil_scoped_acquire>();
+      dispatcher_->Leave();
+    }
+  }
+};
+
+// Arguments of a stub, given to a stub process on its command line, or to a
+// shared stub process for each of its models.
+struct StubArguments {
+  std::string model_path;  // Path to model.py
+  std::string shm_region_name;
+  int64_t shm_default_size;
+  int64_t shm_growth_size;
+  pid_t parent_pid;
+  std::string triton_install_path;
+  int64_t copy_thread_count;
+  int64_t copy_parallel_byte_size;
+  int64_t execute_thread_count;
+  std::string model_version;  // Name of the version directory of the model
+};
+
+// Parse the stub arguments 'argv' to 'args'. Returns false, once the error is
+// logged, if they are not valid.
+bool
+ParseStubArguments(int argc, char** argv, StubArguments& args)
 {
   if (argc < 7) {
     LOG_INFO << "Expected 7 arguments, found " << argc << " arguments.";
-    exit(1);
+    return false;
   }
-  signal(SIGINT, SignalHandler);
-  signal(SIGTERM, SigtermHandler);
 
-  // Path to model.py
-  std::string model_path = argv[1];
-  std::string shm_region_name = argv[2];
-  int64_t shm_default_size = std::stoi(argv[3]);
+  args.model_path = argv[1];
+  args.shm_region_name = argv[2];
+  args.shm_default_size = std::stoi(argv[3]);
 
   std::vector<std::string> model_path_tokens;
 
   // Find the package name from model path.
+  const std::string& model_path = args.model_path;
   size_t prev = 0, pos = 0;
   do {
     pos = model_path.find("/", prev);
@@ -716,81 +1798,478 @@ main(int argc, char** argv)
 
   if (model_path_tokens.size() < 2) {
     LOG_INFO << "Model path does not look right: " << model_path;
-    exit(1);
+    return false;
+  }
+  args.model_version = model_path_tokens[model_path_tokens.size() - 2];
+  args.shm_growth_size = std::stoi(argv[4]);
+  args.parent_pid = std::stoi(argv[5]);
+  args.triton_install_path = argv[6];
+
+  // The copy engine settings are optional so that custom stubs can be used
+  // with older backends.
+  args.copy_thread_count = 1;
+  args.copy_parallel_byte_size = 8 * 1024 * 1024;
+  if (argc >= 9) {
+    args.copy_thread_count = std::stol(argv[7]);
+    args.copy_parallel_byte_size = std::stol(argv[8]);
   }
-  std::string model_version = model_path_tokens[model_path_tokens.size() - 2];
-  int64_t shm_growth_size = std::stoi(argv[4]);
-  pid_t parent_pid = std::stoi(argv[5]);
-  std::string triton_install_path = argv[6];
+  args.execute_thread_count = 1;
+  if (argc >= 10) {
+    args.execute_thread_count = std::stol(argv[9]);
+  }
+
+  return true;
+}
 
-  std::unique_ptr<Stub> stub;
+// Create the stub described by 'args'. Returns nullptr, once the error is
+// logged, on failure.
+std::unique_ptr<Stub>
+CreateStub(StubArguments& args)
+{
   try {
-    stub = std::make_unique<Stub>(
-        shm_growth_size, shm_default_size, shm_region_name, model_path);
+    return std::make_unique<Stub>(
+        args.shm_growth_size, args.shm_default_size, args.shm_region_name,
+        args.model_path, args.copy_thread_count, args.copy_parallel_byte_size,
+        args.execute_thread_count);
   }
   catch (const PythonBackendException& pb_exception) {
     LOG_INFO << "Failed to preinitialize Python stub: " << pb_exception.what();
-    exit(1);
+    return nullptr;
   }
+}
 
-  // Exit if it has received a SIGTERM signal.
-  if (stub->WaitForNotification()) {
-    LOG_INFO << "Received SIGTERM: exiting.";
-    exit(1);
+// Initialize the model of 'stub', and execute its request batches until the
+// parent process asks it to exit. 'dispatcher' is nullptr if the stub process
+// only serves this model. Otherwise the model is imported under a name of
+// its own, since the models share the interpreter. Returns the exit code.
+int
+ServeStub(
+    std::unique_ptr<Stub>& stub, StubArguments& args,
+    FairDispatcher* dispatcher)
+{
+  std::string module_name;
+  if (dispatcher != nullptr) {
+    module_name = "triton_model";
+    for (char c : args.shm_region_name) {
+      module_name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
   }
 
-  // Start the Python Interpreter
-  py::scoped_interpreter guard{};
+  bool initialized;
+  {
+    ModelTurn turn(dispatcher);
+    initialized = stub->Initialize(
+        args.model_version, args.triton_install_path, module_name);
+  }
+  if (!initialized) {
+    return 1;
+  }
 
-  stub->Initialize(model_version, argv[6] /* triton install path */);
   std::atomic<bool> non_graceful_exit = {false};
+  pid_t parent_pid = args.parent_pid;
+
+  // The thread that runs the model, which is interrupted if the parent
+  // process aborts the stub of a shared stub process.
+  const unsigned long model_thread_id = PyThread_get_thread_ident();
+  std::atomic<bool> interrupted = {false};
 
   std::atomic<bool> background_thread_running = {true};
-  std::thread background_thread(
-      [&parent_pid, &background_thread_running, &stub, &non_graceful_exit] {
-        while (background_thread_running) {
-          // Every 300ms set the health variable to true. This variable is in
-          // shared memory and will be set to false by the parent process.
-          // The parent process expects that the stub process sets this variable
-          // to true within 1 second.
-          sleep(0.3);
-
-          stub->UpdateHealth();
-          if (sigterm_received) {
-            background_thread_running = false;
-          }
+  std::thread background_thread([&parent_pid, &background_thread_running,
+                                 &stub, &non_graceful_exit, &interrupted,
+                                 model_thread_id, dispatcher] {
+    while (background_thread_running) {
+      // Every 300ms set the health variable to true. This variable is in
+      // shared memory and will be set to false by the parent process.
+      // The parent process expects that the stub process sets this variable
+      // to true within 1 second.
+      sleep(0.3);
+
+      stub->UpdateHealth();
+      if (sigterm_received) {
+        background_thread_running = false;
+      }
 
-          if (kill(parent_pid, 0) != 0) {
-            // Destroy Stub
-            stub.reset();
-            LOG_INFO << "Non-graceful termination detected. ";
-            background_thread_running = false;
-            non_graceful_exit = true;
-            sigterm_received = true;
-          }
+      // A model of a shared stub process that is stuck in Python code gets a
+      // SystemExit exception, raised the next time its thread runs Python
+      // code. A model that is stuck in native code is not interrupted, and
+      // the parent process then kills the whole stub process.
+      if (dispatcher != nullptr && !interrupted && stub->AbortRequested()) {
+        interrupted = true;
+        LOG_INFO << "The stub has been aborted by the parent process.";
+        py::gil_scoped_acquire gil;
+        PyThreadState_SetAsyncExc(model_thread_id, PyExc_SystemExit);
+      }
+
+      if (kill(parent_pid, 0) != 0) {
+        // Destroy Stub. The stubs of a shared stub process are destroyed by
+        // their own threads, which hold the GIL meanwhile.
+        if (dispatcher == nullptr) {
+          stub.reset();
         }
-      });
+        LOG_INFO << "Non-graceful termination detected. ";
+        background_thread_running = false;
+        non_graceful_exit = true;
+        sigterm_received = true;
+      }
+    }
+  });
 
   // Wait for messages from the parent process
+  stub->NotifyParent();
   while (true) {
-    stub->NotifyParent();
     if (stub->WaitForNotification()) {
       break;
     }
 
-    int stop = stub->Execute();
+    int stop;
+    {
+      ModelTurn turn(dispatcher);
+      try {
+        stop = stub->Execute();
+      }
+      catch (const py::error_already_set& e) {
+        // The exception that aborts the stub can be raised outside of the
+        // error handling of the request batch.
+        LOG_INFO << e.what();
+        stop = 1;
+      }
+    }
     if (stop)
       break;
+
+    stub->NotifyBatchDone();
   }
 
-  if (!non_graceful_exit) {
-    stub->Finalize();
+  if (!stub->AbortRequested() && !non_graceful_exit) {
+    {
+      ModelTurn turn(dispatcher);
+      stub->Finalize();
+    }
     stub->NotifyParent();
   }
 
   background_thread_running = false;
   background_thread.join();
+
+  // Clear the exception in case it has not been raised yet.
+  if (interrupted) {
+    ModelTurn turn(dispatcher);
+    PyThreadState_SetAsyncExc(model_thread_id, nullptr);
+  }
+  return 0;
+}
+
+// Run the stub with the arguments 'argv'. 'forked' is true if the stub
+// process has been forked from a zygote, whose Python interpreter is already
+// started.
+int
+RunStub(int argc, char** argv, bool forked)
+{
+  StubArguments args;
+  if (!ParseStubArguments(argc, argv, args)) {
+    exit(1);
+  }
+  signal(SIGINT, SignalHandler);
+  signal(SIGTERM, SigtermHandler);
+
+  std::unique_ptr<Stub> stub = CreateStub(args);
+  if (stub == nullptr) {
+    exit(1);
+  }
+
+  // Exit if it has received a SIGTERM signal.
+  if (stub->WaitForNotification()) {
+    LOG_INFO << "Received SIGTERM: exiting.";
+    exit(1);
+  }
+
+  // Start the Python Interpreter
+  std::unique_ptr<py::scoped_interpreter> guard;
+  if (!forked) {
+    guard = std::make_unique<py::scoped_interpreter>();
+  }
+
+  if (ServeStub(stub, args, nullptr /* dispatcher */) != 0) {
+    exit(1);
+  }
+  return 0;
+}
+
+// A thread of a shared stub process that serves a model.
+struct ModelThread {
+  std::thread thread;
+  std::atomic<bool> stopped;
+};
+
+// Serve a model of a shared stub process, whose stub has the arguments
+// 'arguments', until the parent process asks it to exit.
+void
+ServeSharedModel(
+    std::vector<std::string> arguments, FairDispatcher* dispatcher)
+{
+  std::vector<char*> argv;
+  for (std::string& argument : arguments) {
+    argv.push_back(&argument[0]);
+  }
+  argv.push_back(nullptr);
+
+  StubArguments args;
+  if (!ParseStubArguments(argv.size() - 1, argv.data(), args)) {
+    return;
+  }
+  std::unique_ptr<Stub> stub = CreateStub(args);
+  if (stub == nullptr) {
+    return;
+  }
+
+  if (!stub->WaitForNotification()) {
+    ServeStub(stub, args, dispatcher);
+  }
+  if (stub->AbortRequested()) {
+    stub->AcknowledgeAbort();
+  }
+
+  // The Python objects of the model are released while holding the GIL.
+  ModelTurn turn(dispatcher);
+  stub.reset();
+}
+
+// Import the modules of a model and run its pre-initialize hook as described
+// by 'config'. Returns the error message, or an empty string on success.
+std::string
+PreloadZygote(std::unordered_map<std::string, std::string>& config)
+{
+  try {
+    py::module sys = py::module::import("sys");
+    std::string model_repository = config["model_repository"];
+    sys.attr("path").attr("append")(
+        model_repository + "/" + config["model_version"]);
+    sys.attr("path").attr("append")(model_repository);
+    sys.attr("path").attr("append")(config["python_lib"]);
+    py::module::import("triton_python_backend_utils");
+
+    std::stringstream modules(config["preload_modules"]);
+    std::string module;
+    while (std::getline(modules, module, ',')) {
+      module.erase(0, module.find_first_not_of(" \t"));
+      module.erase(module.find_last_not_of(" \t") + 1);
+      if (!module.empty()) {
+        LOG_INFO << "Preloading module " << module;
+        py::module::import(module.c_str());
+      }
+    }
+
+    // The hook is '<module>:<function>', and is called with the model
+    // configuration and the name, version and repository of the model.
+    std::string hook = config["preinitialize_hook"];
+    if (!hook.empty()) {
+      size_t colon = hook.find(':');
+      if (colon == std::string::npos) {
+        return "The pre-initialize hook '" + hook +
+               "' is not in the '<module>:<function>' format.";
+      }
+      py::dict args;
+      for (const char* key :
+           {"model_config", "model_name", "model_version",
+            "model_repository"}) {
+        args[key] = config[key];
+      }
+      py::module::import(hook.substr(0, colon).c_str())
+          .attr(hook.substr(colon + 1).c_str())(args);
+    }
+  }
+  catch (const py::error_already_set& e) {
+    return e.what();
+  }
+
+  return std::string();
+}
+
+// Run a zygote, which receives the requests of the parent process on the
+// kZygoteControlSocket socket. The first request is the configuration of the
+// model, as name and value pairs, and the other ones are the arguments of the
+// stub processes to fork. A forked stub process returns from this function,
+// and runs the stub with these arguments.
+int
+RunZygote()
+{
+  signal(SIGINT, SignalHandler);
+
+  // The forked stub processes are reaped automatically.
+  signal(SIGCHLD, SIG_IGN);
+
+  const int control_socket = kZygoteControlSocket;
+  std::vector<std::string> message;
+  std::unordered_map<std::string, std::string> config;
+  try {
+    if (!ReceiveStrings(control_socket, message)) {
+      return 1;
+    }
+    for (size_t i = 0; i + 1 < message.size(); i += 2) {
+      config[message[i]] = message[i + 1];
+    }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_INFO << "Failed to start the stub zygote: " << pb_exception.what();
+    return 1;
+  }
+
+  py::scoped_interpreter guard{};
+  std::string error = PreloadZygote(config);
+  try {
+    if (error.empty()) {
+      SendStrings(control_socket, {});
+    } else {
+      LOG_INFO << "Failed to preload the stub zygote: " << error;
+      SendStrings(control_socket, {error});
+      return 1;
+    }
+
+    // The parent process closes the socket when the model is unloaded.
+    while (ReceiveStrings(control_socket, message)) {
+      PyOS_BeforeFork();
+      pid_t pid = fork();
+      if (pid == 0) {
+        PyOS_AfterFork_Child();
+        close(control_socket);
+        signal(SIGCHLD, SIG_DFL);
+
+        std::vector<char*> argv;
+        for (std::string& arg : message) {
+          argv.push_back(&arg[0]);
+        }
+        argv.push_back(nullptr);
+        return RunStub(message.size(), argv.data(), true /* forked */);
+      }
+
+      std::string fork_error = (pid == -1) ? strerror(errno) : "";
+      PyOS_AfterFork_Parent();
+      SendStrings(control_socket, {std::to_string(pid), fork_error});
+    }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_INFO << "Stub zygote failed: " << pb_exception.what();
+    return 1;
+  }
+
+  return 0;
+}
+
+// Run a shared stub process, which serves the models whose stub arguments it
+// receives on the kZygoteControlSocket socket, each from a thread of its own,
+// with a single Python interpreter. The first request is the configuration of
+// the stub process, as name and value pairs. Each request is replied to with
+// the pid of this process.
+int
+RunSharedStub()
+{
+  signal(SIGINT, SignalHandler);
+  signal(SIGTERM, SigtermHandler);
+
+  const int control_socket = kZygoteControlSocket;
+  std::vector<std::string> message;
+  std::unordered_map<std::string, std::string> config;
+  try {
+    if (!ReceiveStrings(control_socket, message)) {
+      return 1;
+    }
+    for (size_t i = 0; i + 1 < message.size(); i += 2) {
+      config[message[i]] = message[i + 1];
+    }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_INFO << "Failed to start the shared stub process: "
+             << pb_exception.what();
+    return 1;
+  }
+
+  py::scoped_interpreter guard{};
+  std::string error;
+  try {
+    py::module::import("sys").attr("path").attr("append")(
+        config["python_lib"]);
+    py::module::import("triton_python_backend_utils");
+  }
+  catch (const py::error_already_set& e) {
+    error = e.what();
+  }
+
+  FairDispatcher dispatcher;
+
+  // The thread of a model is joined once its stub has stopped, e.g. when the
+  // model is unloaded or its stub is replaced, which is checked at least
+  // every second.
+  std::list<std::unique_ptr<ModelThread>> model_threads;
+  auto join_stopped_model_threads = [&model_threads] {
+    for (auto it = model_threads.begin(); it != model_threads.end();) {
+      if ((*it)->stopped) {
+        (*it)->thread.join();
+        it = model_threads.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  };
+  {
+    // The models take the GIL from their own threads.
+    py::gil_scoped_release release;
+    try {
+      if (!error.empty()) {
+        LOG_INFO << "Failed to start the shared stub process: " << error;
+        SendStrings(control_socket, {error});
+        return 1;
+      }
+      SendStrings(control_socket, {});
+
+      // The parent process closes the socket when the backend is finalized.
+      while (true) {
+        pollfd control = {control_socket, POLLIN, 0};
+        const int ready = poll(&control, 1, 1000 /* ms */);
+        join_stopped_model_threads();
+        if ((ready == 0) || ((ready == -1) && (errno == EINTR))) {
+          continue;
+        }
+        if (!ReceiveStrings(control_socket, message)) {
+          break;
+        }
+
+        model_threads.emplace_back(new ModelThread());
+        ModelThread* model_thread = model_threads.back().get();
+        model_thread->stopped = false;
+        model_thread->thread =
+            std::thread([message, &dispatcher, model_thread] {
+              ServeSharedModel(message, &dispatcher);
+              model_thread->stopped = true;
+            });
+        SendStrings(control_socket, {std::to_string(getpid()), ""});
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_INFO << "Shared stub process failed: " << pb_exception.what();
+    }
+
+    sigterm_received = true;
+    for (auto& model_thread : model_threads) {
+      model_thread->thread.join();
+    }
+  }
+
   return 0;
 }
+
+extern "C" {
+
+int
+main(int argc, char** argv)
+{
+  if (argc >= 2 && std::string(argv[1]) == "--zygote") {
+    return RunZygote();
+  }
+  if (argc >= 2 && std::string(argv[1]) == "--shared") {
+    return RunSharedStub();
+  }
+
+  return RunStub(argc, argv, false /* forked */);
+}
 }
 }}}  // namespace triton::backend::python
@@ -34,13 +34,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include "shm_manager.h"
 
@@ -97,6 +104,21 @@ SaveRawDataToSharedMemory(
   raw_data->memory_ptr = buffer_offset;
 }
 
+void
+SaveRawDataViewToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, off_t& raw_data_offset,
+    off_t data_offset, TRITONSERVER_MemoryType memory_type,
+    int memory_type_id, uint64_t byte_size)
+{
+  RawData* raw_data;
+  shm_pool->Map((char**)&raw_data, sizeof(RawData), raw_data_offset);
+
+  raw_data->memory_type = memory_type;
+  raw_data->memory_type_id = memory_type_id;
+  raw_data->byte_size = byte_size;
+  raw_data->memory_ptr = data_offset;
+}
+
 void
 SaveMapToSharedMemory(
     std::unique_ptr<SharedMemory>& shm_pool, off_t& shm_offset,
@@ -139,19 +161,10 @@ LoadMapFromSharedMemory(
 }
 
 void
-SaveTensorToSharedMemory(
-    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor,
-    char*& raw_data_ptr, TRITONSERVER_MemoryType memory_type,
-    int memory_type_id, uint64_t byte_size, const char* name,
+SaveTensorMetadataToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor, const char* name,
     const int64_t* dims, size_t dims_count, TRITONSERVER_DataType dtype)
 {
-  // Raw Data
-  off_t raw_data_offset;
-  SaveRawDataToSharedMemory(
-      shm_pool, raw_data_offset, raw_data_ptr, memory_type, memory_type_id,
-      byte_size);
-  tensor->raw_data = raw_data_offset;
-
   // name
   off_t name_offset;
   SaveStringToSharedMemory(shm_pool, name_offset, name);
@@ -160,7 +173,14 @@ SaveTensorToSharedMemory(
   // input dtype
   tensor->dtype = dtype;
 
-  // input dims
+  SaveTensorDimsToSharedMemory(shm_pool, tensor, dims, dims_count);
+}
+
+void
+SaveTensorDimsToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor,
+    const int64_t* dims, size_t dims_count)
+{
   int64_t* tensor_dims;
   tensor->dims_count = dims_count;
   off_t tensor_dims_offset;
@@ -174,115 +194,349 @@ SaveTensorToSharedMemory(
 }
 
 void
-CopySingleArchiveEntry(archive* input_archive, archive* output_archive)
+SaveTensorToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor,
+    char*& raw_data_ptr, TRITONSERVER_MemoryType memory_type,
+    int memory_type_id, uint64_t byte_size, const char* name,
+    const int64_t* dims, size_t dims_count, TRITONSERVER_DataType dtype)
+{
+  // Raw Data
+  off_t raw_data_offset;
+  SaveRawDataToSharedMemory(
+      shm_pool, raw_data_offset, raw_data_ptr, memory_type, memory_type_id,
+      byte_size);
+  tensor->raw_data = raw_data_offset;
+
+  SaveTensorMetadataToSharedMemory(
+      shm_pool, tensor, name, dims, dims_count, dtype);
+}
+
+void
+SaveTensorViewToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor, off_t data_offset,
+    TRITONSERVER_MemoryType memory_type, int memory_type_id,
+    uint64_t byte_size, const char* name, const int64_t* dims,
+    size_t dims_count, TRITONSERVER_DataType dtype)
 {
+  // Raw Data pointing to the existing buffer
+  off_t raw_data_offset;
+  SaveRawDataViewToSharedMemory(
+      shm_pool, raw_data_offset, data_offset, memory_type, memory_type_id,
+      byte_size);
+  tensor->raw_data = raw_data_offset;
+
+  SaveTensorMetadataToSharedMemory(
+      shm_pool, tensor, name, dims, dims_count, dtype);
+}
+
+// An entry of an archive read to memory, which is written to the disk by a
+// writer thread of ExtractTarFile.
+struct ArchiveFile {
+  archive_entry* entry;
+
+  // Data blocks of the entry and their offsets
+  std::vector<std::pair<int64_t, std::string>> blocks;
+  size_t byte_size;
+};
+
+// Write 'entry' and the data blocks returned by 'next_block' to the disk with
+// 'output_archive'.
+static void
+WriteArchiveEntry(
+    archive* output_archive, archive_entry* entry,
+    const std::function<bool(const void**, size_t*, int64_t*)>& next_block)
+{
+  int write_status = archive_write_header(output_archive, entry);
+  if (write_status != ARCHIVE_OK) {
+    throw PythonBackendException(
+        std::string("archive_write_header() failed with error code = ") +
+        std::to_string(write_status) + " error message is " +
+        archive_error_string(output_archive));
+  }
+
   const void* buff;
   size_t size;
-#if ARCHIVE_VERSION_NUMBER >= 3000000
   int64_t offset;
-#else
-  off_t offset;
-#endif
-
-  for (;;) {
-    int return_status;
-    return_status =
-        archive_read_data_block(input_archive, &buff, &size, &offset);
-    if (return_status == ARCHIVE_EOF)
-      break;
-    if (return_status != ARCHIVE_OK)
-      throw PythonBackendException(
-          "archive_read_data_block() failed with error code = " +
-          std::to_string(return_status));
-
-    return_status =
+  while (next_block(&buff, &size, &offset)) {
+    write_status =
         archive_write_data_block(output_archive, buff, size, offset);
-    if (return_status != ARCHIVE_OK) {
+    if (write_status != ARCHIVE_OK) {
       throw PythonBackendException(
           "archive_write_data_block() failed with error code = " +
-          std::to_string(return_status) + ", error message is " +
+          std::to_string(write_status) + ", error message is " +
           archive_error_string(output_archive));
     }
   }
-}
 
-void
-ExtractTarFile(std::string& archive_path, std::string& dst_path)
-{
-  char current_directory[PATH_MAX];
-  if (getcwd(current_directory, PATH_MAX) == nullptr) {
+  write_status = archive_write_finish_entry(output_archive);
+  if (write_status != ARCHIVE_OK) {
     throw PythonBackendException(
-        (std::string("Failed to get the current working directory. Error: ") +
-         std::strerror(errno)));
-  }
-  if (chdir(dst_path.c_str()) == -1) {
-    throw PythonBackendException(
-        (std::string("Failed to change the directory to ") + dst_path +
-         " Error: " + std::strerror(errno))
-            .c_str());
+        std::string("archive_write_finish_entry() failed with error code = ") +
+        std::to_string(write_status) + " error message is " +
+        archive_error_string(output_archive));
   }
+}
 
-  struct archive_entry* entry;
-  int flags = ARCHIVE_EXTRACT_TIME;
+static archive*
+NewDiskArchive()
+{
+  archive* output_archive = archive_write_disk_new();
+  archive_write_disk_set_options(output_archive, ARCHIVE_EXTRACT_TIME);
+  return output_archive;
+}
 
-  struct archive* input_archive = archive_read_new();
-  struct archive* output_archive = archive_write_disk_new();
-  archive_write_disk_set_options(output_archive, flags);
+static void
+FreeDiskArchive(archive* output_archive)
+{
+  archive_write_close(output_archive);
+  archive_write_free(output_archive);
+}
 
-  archive_read_support_filter_gzip(input_archive);
-  archive_read_support_format_tar(input_archive);
+// Prefix the path of 'entry', and the target of a hard link, with 'dst_path'.
+static void
+SetArchiveEntryDestination(archive_entry* entry, const std::string& dst_path)
+{
+  const char* pathname = archive_entry_pathname(entry);
+  if (pathname != nullptr) {
+    archive_entry_set_pathname(entry, (dst_path + "/" + pathname).c_str());
+  }
+  const char* hardlink = archive_entry_hardlink(entry);
+  if (hardlink != nullptr) {
+    archive_entry_set_hardlink(entry, (dst_path + "/" + hardlink).c_str());
+  }
+}
 
+ExtractionStats
+ExtractTarFile(
+    std::string& archive_path, std::string& dst_path,
+    size_t writer_thread_count)
+{
   if (archive_path.size() == 0) {
     throw PythonBackendException("The archive path is empty.");
   }
 
-  THROW_IF_ERROR(
-      "archive_read_open_filename() failed.",
-      archive_read_open_filename(
-          input_archive, archive_path.c_str(), 10240 /* block_size */));
+  // The archive is decompressed by this thread, while the writer threads
+  // create the files. Entries that are larger than the data that can be
+  // queued for the writer threads are written by this thread.
+  const size_t kReadBlockSize = 1024 * 1024;
+  const size_t kMaxQueuedByteSize = 64 * 1024 * 1024;
+  ExtractionStats stats = {};
+  auto start = std::chrono::steady_clock::now();
 
-  while (true) {
-    int read_status = archive_read_next_header(input_archive, &entry);
-    if (read_status == ARCHIVE_EOF)
-      break;
-    if (read_status != ARCHIVE_OK) {
-      throw PythonBackendException(
-          std::string("archive_read_next_header() failed with error code = ") +
-          std::to_string(read_status) + std::string(" error message is ") +
-          archive_error_string(input_archive));
+  struct archive* input_archive = archive_read_new();
+  archive_read_support_filter_gzip(input_archive);
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+  archive_read_support_filter_zstd(input_archive);
+#endif
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+  archive_read_support_filter_lz4(input_archive);
+#endif
+  archive_read_support_format_tar(input_archive);
+  if (archive_read_open_filename(
+          input_archive, archive_path.c_str(), kReadBlockSize) != ARCHIVE_OK) {
+    std::string message = std::string("archive_read_open_filename() failed: ") +
+                          archive_error_string(input_archive);
+    archive_read_free(input_archive);
+    throw PythonBackendException(message);
+  }
+
+  std::deque<std::unique_ptr<ArchiveFile>> queue;
+  size_t queued_byte_size = 0;
+  bool reading_done = false;
+  std::string error;
+  std::mutex mu;
+  std::condition_variable queue_cv;
+  std::condition_variable space_cv;
+
+  // Closing a disk archive applies the permissions and times of the
+  // directories that it has created, which must wait until no thread creates
+  // entries in them anymore. The archives of the writer threads are closed
+  // once all the threads are done.
+  std::vector<archive*> writer_archives;
+
+  auto writer_loop = [&] {
+    archive* output_archive = NewDiskArchive();
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      writer_archives.push_back(output_archive);
+    }
+    while (true) {
+      std::unique_ptr<ArchiveFile> file;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        queue_cv.wait(lock, [&] { return reading_done || !queue.empty(); });
+        if (queue.empty()) {
+          break;
+        }
+        file = std::move(queue.front());
+        queue.pop_front();
+      }
+
+      size_t b = 0;
+      try {
+        WriteArchiveEntry(
+            output_archive, file->entry,
+            [&file, &b](const void** buff, size_t* size, int64_t* offset) {
+              if (b == file->blocks.size()) {
+                return false;
+              }
+              *buff = file->blocks[b].second.data();
+              *size = file->blocks[b].second.size();
+              *offset = file->blocks[b].first;
+              b++;
+              return true;
+            });
+      }
+      catch (const PythonBackendException& pb_exception) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (error.empty()) {
+          error = pb_exception.what();
+        }
+      }
+      archive_entry_free(file->entry);
+
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        queued_byte_size -= file->byte_size;
+      }
+      space_cv.notify_one();
     }
+  };
+
+  std::vector<std::thread> writer_threads;
+  for (size_t i = 0; i < writer_thread_count; i++) {
+    writer_threads.emplace_back(writer_loop);
+  }
 
-    read_status = archive_write_header(output_archive, entry);
-    if (read_status != ARCHIVE_OK) {
-      throw PythonBackendException(std::string(
-          "archive_write_header() failed with error code = " +
-          std::to_string(read_status) + std::string(" error message is ") +
-          archive_error_string(output_archive)));
+  // Hard links are created once all the other entries, and their targets,
+  // have been written.
+  std::vector<archive_entry*> hardlinks;
+  archive* output_archive = NewDiskArchive();
+  try {
+    archive_entry* entry;
+    while (true) {
+      int read_status = archive_read_next_header(input_archive, &entry);
+      if (read_status == ARCHIVE_EOF) {
+        break;
+      }
+      if (read_status != ARCHIVE_OK) {
+        throw PythonBackendException(
+            std::string(
+                "archive_read_next_header() failed with error code = ") +
+            std::to_string(read_status) + " error message is " +
+            archive_error_string(input_archive));
+      }
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!error.empty()) {
+          throw PythonBackendException(error);
+        }
+      }
+
+      stats.entry_count++;
+      SetArchiveEntryDestination(entry, dst_path);
+      const size_t entry_size = archive_entry_size(entry);
+      stats.byte_size += entry_size;
+      if (archive_entry_hardlink(entry) != nullptr) {
+        hardlinks.push_back(archive_entry_clone(entry));
+        continue;
+      }
+
+      if (writer_thread_count == 0 || entry_size > kMaxQueuedByteSize) {
+        WriteArchiveEntry(
+            output_archive, entry,
+            [input_archive](const void** buff, size_t* size, int64_t* offset) {
+              int status =
+                  archive_read_data_block(input_archive, buff, size, offset);
+              if (status == ARCHIVE_EOF) {
+                return false;
+              }
+              if (status != ARCHIVE_OK) {
+                throw PythonBackendException(
+                    "archive_read_data_block() failed with error code = " +
+                    std::to_string(status));
+              }
+              return true;
+            });
+        continue;
+      }
+
+      std::unique_ptr<ArchiveFile> file(new ArchiveFile());
+      file->entry = archive_entry_clone(entry);
+      file->byte_size = 0;
+      const void* buff;
+      size_t size;
+      int64_t offset;
+      int status;
+      while ((status = archive_read_data_block(
+                  input_archive, &buff, &size, &offset)) == ARCHIVE_OK) {
+        file->blocks.emplace_back(
+            offset, std::string(reinterpret_cast<const char*>(buff), size));
+        file->byte_size += size;
+      }
+      if (status != ARCHIVE_EOF) {
+        archive_entry_free(file->entry);
+        throw PythonBackendException(
+            "archive_read_data_block() failed with error code = " +
+            std::to_string(status));
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        space_cv.wait(lock, [&] {
+          return queue.empty() ||
+                 queued_byte_size + file->byte_size <= kMaxQueuedByteSize;
+        });
+        queued_byte_size += file->byte_size;
+        queue.push_back(std::move(file));
+      }
+      queue_cv.notify_one();
     }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    std::lock_guard<std::mutex> lock(mu);
+    if (error.empty()) {
+      error = pb_exception.what();
+    }
+  }
 
-    CopySingleArchiveEntry(input_archive, output_archive);
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    reading_done = true;
+  }
+  queue_cv.notify_all();
+  for (auto& writer_thread : writer_threads) {
+    writer_thread.join();
+  }
 
-    read_status = archive_write_finish_entry(output_archive);
-    if (read_status != ARCHIVE_OK) {
-      throw PythonBackendException(std::string(
-          "archive_write_finish_entry() failed with error code = " +
-          std::to_string(read_status) + std::string(" error message is ") +
-          archive_error_string(output_archive)));
+  for (archive_entry* hardlink : hardlinks) {
+    if (error.empty()) {
+      try {
+        WriteArchiveEntry(
+            output_archive, hardlink,
+            [](const void**, size_t*, int64_t*) { return false; });
+      }
+      catch (const PythonBackendException& pb_exception) {
+        error = pb_exception.what();
+      }
     }
+    archive_entry_free(hardlink);
   }
 
+  for (archive* writer_archive : writer_archives) {
+    FreeDiskArchive(writer_archive);
+  }
+  FreeDiskArchive(output_archive);
   archive_read_close(input_archive);
   archive_read_free(input_archive);
-
-  archive_write_close(output_archive);
-  archive_write_free(output_archive);
-
-  // Revert the directory change.
-  if (chdir(current_directory) == -1) {
-    throw PythonBackendException(
-        (std::string("Failed to change the directory to ") + current_directory)
-            .c_str());
+  if (!error.empty()) {
+    throw PythonBackendException(error);
   }
+
+  stats.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  return stats;
 }
 
 bool
@@ -292,4 +546,87 @@ FileExists(std::string& path)
   return stat(path.c_str(), &buffer) == 0;
 }
 
+void
+SendStrings(int socket, const std::vector<std::string>& strings)
+{
+  // Each string is sent as its length followed by its bytes, after the number
+  // of strings.
+  std::string message;
+  uint64_t count = strings.size();
+  message.append(reinterpret_cast<char*>(&count), sizeof(count));
+  for (const std::string& str : strings) {
+    uint64_t length = str.size();
+    message.append(reinterpret_cast<char*>(&length), sizeof(length));
+    message.append(str);
+  }
+
+  size_t sent = 0;
+  while (sent < message.size()) {
+    ssize_t n = send(
+        socket, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw PythonBackendException(
+          std::string("Failed to send a message: ") + strerror(errno));
+    }
+    sent += n;
+  }
+}
+
+// Receive 'size' bytes from 'socket' to 'data'. Returns the number of bytes
+// received before the socket has been closed by the peer.
+static size_t
+ReceiveBytes(int socket, char* data, size_t size)
+{
+  size_t received = 0;
+  while (received < size) {
+    ssize_t n = recv(socket, data + received, size - received, 0);
+    if (n == 0) {
+      break;
+    }
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw PythonBackendException(
+          std::string("Failed to receive a message: ") + strerror(errno));
+    }
+    received += n;
+  }
+
+  return received;
+}
+
+bool
+ReceiveStrings(int socket, std::vector<std::string>& strings)
+{
+  strings.clear();
+  uint64_t count;
+  size_t received = ReceiveBytes(socket, (char*)&count, sizeof(count));
+  if (received == 0) {
+    return false;
+  }
+
+  const char* truncated_message = "Received a truncated message.";
+  if (received != sizeof(count)) {
+    throw PythonBackendException(truncated_message);
+  }
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t length;
+    if (ReceiveBytes(socket, (char*)&length, sizeof(length)) !=
+        sizeof(length)) {
+      throw PythonBackendException(truncated_message);
+    }
+    std::string str(length, '\0');
+    if (ReceiveBytes(socket, &str[0], length) != length) {
+      throw PythonBackendException(truncated_message);
+    }
+    strings.push_back(std::move(str));
+  }
+
+  return true;
+}
+
 }}}  // namespace triton::backend::python
@@ -111,17 +111,54 @@ struct Response {
   bool is_error_set;  // Indicates whether this error has a message or not.
 };
 
+//
+// An entry of the completion queue of a ResponseBatch.
+//
+struct CompletedResponse {
+  uint32_t request_index;
+  uint32_t flags;  // TRITONSERVER_ResponseCompleteFlag
+  off_t response;  // Offset of the Response, 0 if only 'flags' are sent.
+  off_t next;      // Offset of the next entry, 0 until it is published.
+};
+
 struct ResponseBatch {
-  off_t responses;  // Offset for response object.
   uint32_t batch_size;
   off_t error;
   bool has_error;
   bool is_error_set;  // Indicates whether this error has a message or not.
+
+  // Completion queue. The stub publishes each response as soon as it is
+  // ready by storing the offset of a new CompletedResponse atomically, first
+  // here and then in the 'next' field of the previous entry. Decoupled models
+  // can publish several responses for each request.
+  off_t completed_responses;
+
+  // Set by the stub, while holding the parent mutex, once it is done with the
+  // request batch.
+  bool batch_done;
+
+  // Set by the parent, while holding the parent mutex, once it has sent all
+  // the published responses. The stub then publishes the next response at
+  // the head of the queue again, and allocates it from the shared memory of
+  // the sent ones, so that a stream of decoupled responses does not grow the
+  // shared memory pool. The entries are published while holding the parent
+  // mutex, so the parent can't miss one when it releases them.
+  bool responses_released;
 };
 
 struct RequestBatch {
   off_t requests;  // Offset for request object.
   uint32_t batch_size;
+
+  // Offset for the Tensor objects shared by all the requests in the batch
+  // (packed ragged inputs and generated batch inputs).
+  off_t batch_inputs;
+  uint32_t batch_input_count;
+
+  // Offset for the initialize arguments of the model version that the stub
+  // must load in place of its model, in a batch of size 0. A batch of size 0
+  // without it terminates the stub.
+  off_t reload;
 };
 
 struct IPCMessage {
@@ -131,6 +168,11 @@ struct IPCMessage {
   // response points to a ResponseBatch struct.
   off_t response_batch;
   bool health;
+
+  // Set by the parent, while holding the health mutex, to stop the stub of a
+  // shared stub process, even in the middle of a batch. The stub clears it
+  // once it no longer uses the shared memory.
+  bool abort;
 };
 
 // Representing a key value pair
@@ -179,18 +221,62 @@ void SaveRawDataToSharedMemory(
     std::unique_ptr<SharedMemory>& shm_pool, off_t& raw_data_offset,
     char*& raw_data_ptr, TRITONSERVER_MemoryType memory_type,
     int memory_type_id, uint64_t byte_size);
+// Same as SaveRawDataToSharedMemory, except that the data is not allocated.
+// 'data_offset' must point to 'byte_size' bytes that are already allocated in
+// the shared memory pool.
+void SaveRawDataViewToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, off_t& raw_data_offset,
+    off_t data_offset, TRITONSERVER_MemoryType memory_type,
+    int memory_type_id, uint64_t byte_size);
+
+// Save the name, data type and dims of 'tensor'.
+void SaveTensorMetadataToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor, const char* name,
+    const int64_t* dims, size_t dims_count, TRITONSERVER_DataType dtype);
+void SaveTensorDimsToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor,
+    const int64_t* dims, size_t dims_count);
 
 void SaveTensorToSharedMemory(
     std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor,
     char*& raw_data_ptr, TRITONSERVER_MemoryType memory_type,
     int memory_type_id, uint64_t byte_size, const char* name,
     const int64_t* dims, size_t dims_count, TRITONSERVER_DataType dtype);
+// Same as SaveTensorToSharedMemory, except that the tensor data is not
+// allocated. 'data_offset' must point to 'byte_size' bytes that are already
+// allocated in the shared memory pool.
+void SaveTensorViewToSharedMemory(
+    std::unique_ptr<SharedMemory>& shm_pool, Tensor* tensor, off_t data_offset,
+    TRITONSERVER_MemoryType memory_type, int memory_type_id,
+    uint64_t byte_size, const char* name, const int64_t* dims,
+    size_t dims_count, TRITONSERVER_DataType dtype);
 void LoadTensorFromSharedMemory(
     std::unique_ptr<SharedMemory>& shm_pool, off_t tensor_shm_offset,
     Tensor& tensor);
 
-void ExtractTarFile(std::string& archive_path, std::string& dst_path);
+struct ExtractionStats {
+  uint64_t entry_count;
+  uint64_t byte_size;  // Uncompressed size of the entries
+  uint64_t duration_ns;
+};
+
+// Extract the tar archive 'archive_path', compressed with gzip, zstd or lz4,
+// or not compressed, to the directory 'dst_path'. The files are created by
+// 'writer_thread_count' threads while the archive is decompressed.
+ExtractionStats ExtractTarFile(
+    std::string& archive_path, std::string& dst_path,
+    size_t writer_thread_count = 0);
 
 bool FileExists(std::string& path);
 
+// File descriptor of the socket that a stub zygote receives its requests on
+constexpr int kZygoteControlSocket = 3;
+
+// Send 'strings' as a single message over the stream socket 'socket'.
+void SendStrings(int socket, const std::vector<std::string>& strings);
+
+// Receive a message sent with SendStrings from 'socket' to 'strings'. Returns
+// false if the socket has been closed by the peer before the message.
+bool ReceiveStrings(int socket, std::vector<std::string>& strings);
+
 }}}  // namespace triton::backend::python
@@ -0,0 +1,206 @@
+// Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pb_zygote.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include "pb_utils.h"
+
+namespace triton { namespace backend { namespace python {
+
+int
+SpawnStubProcess(
+    std::vector<std::string>& args, char** envp,
+    const posix_spawn_file_actions_t* file_actions, pid_t* pid)
+{
+  std::vector<char*> argv;
+  for (std::string& arg : args) {
+    argv.push_back(&arg[0]);
+  }
+  argv.push_back(nullptr);
+
+  // The stub process is spawned without copying the address space of this
+  // process, and with the signals that the server blocks or handles reset.
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t signals;
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attr, &signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  posix_spawnattr_setsigdefault(&attr, &signals);
+  posix_spawnattr_setflags(
+      &attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  int err =
+      posix_spawn(pid, argv[0], file_actions, &attr, argv.data(), envp);
+  posix_spawnattr_destroy(&attr);
+  return err;
+}
+
+StubZygote::StubZygote(
+    const std::string& stub_path, char** envp,
+    const std::unordered_map<std::string, std::string>& config, bool shared)
+    : pid_(0), socket_(-1)
+{
+  static std::atomic<uint64_t> zygote_count(0);
+  generation_ = ++zygote_count;
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1) {
+    throw PythonBackendException(
+        std::string("Failed to create the socket of the stub zygote: ") +
+        strerror(errno));
+  }
+  socket_ = sockets[0];
+
+  // The other socket is only inherited by the zygote, as its control socket.
+  posix_spawn_file_actions_t file_actions;
+  posix_spawn_file_actions_init(&file_actions);
+  posix_spawn_file_actions_adddup2(
+      &file_actions, sockets[1], kZygoteControlSocket);
+  std::vector<std::string> args = {
+      stub_path, shared ? "--shared" : "--zygote"};
+  int err = SpawnStubProcess(args, envp, &file_actions, &pid_);
+  posix_spawn_file_actions_destroy(&file_actions);
+  close(sockets[1]);
+  if (err != 0) {
+    pid_ = 0;
+    close(socket_);
+    throw PythonBackendException(
+        std::string("Failed to run the stub zygote ") + stub_path +
+        ". Errno = " + std::to_string(err));
+  }
+
+  // The zygote replies with an empty message once the modules are imported,
+  // or with the error.
+  std::vector<std::string> message;
+  for (const auto& pair : config) {
+    message.push_back(pair.first);
+    message.push_back(pair.second);
+  }
+  std::vector<std::string> reply;
+  try {
+    SendStrings(socket_, message);
+    if (!ReceiveStrings(socket_, reply)) {
+      throw PythonBackendException("The stub zygote has exited unexpectedly.");
+    }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    Stop();
+    throw;
+  }
+  if (!reply.empty()) {
+    Stop();
+    throw PythonBackendException(
+        std::string("Failed to preload the stub zygote: ") + reply[0]);
+  }
+}
+
+StubZygote::~StubZygote()
+{
+  Stop();
+}
+
+void
+StubZygote::Stop()
+{
+  // The zygote exits once the socket is closed. The stub processes forked
+  // from it keep running.
+  if (socket_ != -1) {
+    close(socket_);
+    socket_ = -1;
+  }
+  if (pid_ != 0) {
+    int status;
+    waitpid(pid_, &status, 0);
+    pid_ = 0;
+  }
+}
+
+bool
+StubZygote::IsAlive()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  int status;
+  if (pid_ != 0 && waitpid(pid_, &status, WNOHANG) != 0) {
+    pid_ = 0;
+  }
+  return pid_ != 0;
+}
+
+bool
+StubZygote::Signal(int signum)
+{
+  // The zygote is only reaped while holding the mutex, so its pid can't be
+  // reused in the meantime.
+  std::lock_guard<std::mutex> lock(mutex_);
+  int status;
+  if (pid_ != 0 && waitpid(pid_, &status, WNOHANG) != 0) {
+    pid_ = 0;
+  }
+  return pid_ != 0 && kill(pid_, signum) == 0;
+}
+
+void
+StubZygote::Kill()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pid_ != 0) {
+    kill(pid_, SIGKILL);
+    int status;
+    waitpid(pid_, &status, 0);
+    pid_ = 0;
+  }
+}
+
+pid_t
+StubZygote::StartStub(const std::vector<std::string>& args)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> reply;
+  SendStrings(socket_, args);
+  if (!ReceiveStrings(socket_, reply)) {
+    throw PythonBackendException("The stub zygote has exited unexpectedly.");
+  }
+
+  // The reply has the pid of the stub process, or -1 and the error.
+  pid_t pid = std::stoi(reply.at(0));
+  if (pid == -1) {
+    throw PythonBackendException(
+        std::string("The stub zygote failed to fork: ") + reply.at(1));
+  }
+
+  return pid;
+}
+
+}}}  // namespace triton::backend::python
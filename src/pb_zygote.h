@@ -0,0 +1,106 @@
+// Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <spawn.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+
+// Spawn the stub executable 'args[0]' with the arguments 'args' and the
+// environment 'envp'. The signals that the server blocks or handles are reset
+// in the stub process. 'file_actions' can be nullptr. Returns the error
+// number of posix_spawn.
+int SpawnStubProcess(
+    std::vector<std::string>& args, char** envp,
+    const posix_spawn_file_actions_t* file_actions, pid_t* pid);
+
+//
+// StubZygote
+//
+// A stub process that starts the Python interpreter and imports the modules
+// of a model once, and then forks the stub processes of the model instances.
+// The forked stub processes share the memory of the zygote, including the
+// imported modules, until they modify it.
+//
+// A shared zygote runs the stubs itself instead, each in a thread, so that
+// the models of all these stubs share a single process and interpreter.
+//
+class StubZygote {
+  pid_t pid_;
+
+  // Number of the zygote, unique in this process, so that the stubs started
+  // in a zygote that has been replaced can tell.
+  uint64_t generation_;
+
+  // Socket of this process connected to the zygote. Only one request is sent
+  // to the zygote at a time.
+  int socket_;
+  std::mutex mutex_;
+
+  // Close the socket and wait for the zygote to exit.
+  void Stop();
+
+ public:
+  // Spawn the zygote with the stub executable 'stub_path' and the environment
+  // 'envp', and wait until it has imported the modules. 'config' has the
+  // 'python_lib', 'model_repository', 'model_name', 'model_version',
+  // 'model_config', 'preload_modules' and 'preinitialize_hook' of the model,
+  // or only the 'python_lib' if the zygote is 'shared'. Throws a
+  // PythonBackendException if the zygote fails to start.
+  StubZygote(
+      const std::string& stub_path, char** envp,
+      const std::unordered_map<std::string, std::string>& config,
+      bool shared = false);
+  ~StubZygote();
+
+  // Whether the zygote is still running
+  bool IsAlive();
+
+  uint64_t Generation() const { return generation_; }
+
+  // Send 'signum' to the zygote if it is still running. Returns false
+  // otherwise, in which case its pid may already belong to another process.
+  bool Signal(int signum);
+
+  // Kill the zygote, along with the stubs that it runs if it is shared, and
+  // wait for it to exit.
+  void Kill();
+
+  // Start a stub that runs with the arguments 'args', which are the same as
+  // the arguments of a spawned stub process, and return the pid of the
+  // process that runs it, i.e. of a forked stub process, or of the zygote if
+  // it is shared. Throws a PythonBackendException on failure.
+  pid_t StartStub(const std::vector<std::string>& args);
+};
+
+}}}  // namespace triton::backend::python
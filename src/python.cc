@@ -30,25 +30,34 @@
 #include <sys/vfs.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
 #include <atomic>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/thread/thread_time.hpp>
 #include <chrono>
+#include <condition_variable>
 #include <csignal>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
 #include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <numeric>
+#include <set>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
+#include "pb_convert.h"
+#include "pb_copy.h"
 #include "pb_env.h"
 #include "pb_utils.h"
+#include "pb_zygote.h"
 #include "shm_manager.h"
 #include "triton/backend/backend_common.h"
 #include "triton/backend/backend_input_collector.h"
@@ -176,14 +185,132 @@ namespace triton { namespace backend { namespace python {
 
 namespace bi = boost::interprocess;
 
+class StubProcess;
+
 struct BackendState {
   std::string python_lib;
   int64_t shm_default_byte_size;
   int64_t shm_growth_byte_size;
   int64_t stub_timeout_seconds;
+  int64_t copy_thread_count;
+  int64_t copy_parallel_byte_size;
+
+  // Directory where the execution environments are extracted and kept across
+  // restarts, empty to extract them to a temporary directory.
+  std::string env_cache_path;
   std::unique_ptr<EnvironmentManager> env_manager;
+
+  // Copies the large tensors to and from the shared memory. Shared by all the
+  // model instances.
+  std::unique_ptr<CopyEngine> copy_engine;
+
+  // Shared stub processes, indexed by their stub executable and execution
+  // environment. Protected by 'shared_stubs_mutex'.
+  std::unordered_map<std::string, std::unique_ptr<StubZygote>> shared_stubs;
+  std::mutex shared_stubs_mutex;
+
+  // Running stub processes of the models that use 'HOT_RELOAD', indexed by
+  // the name of their shared memory region, which the same model instance of
+  // the next version of the model uses too. Protected by
+  // 'reloadable_stubs_mutex'.
+  std::unordered_map<std::string, std::weak_ptr<StubProcess>>
+      reloadable_stubs;
+  std::mutex reloadable_stubs_mutex;
+};
+
+//
+// BatchInput
+//
+// A tensor generated by the backend for the whole batch, as described by the
+// 'batch_input' section of the model configuration.
+//
+struct BatchInput {
+  enum class Kind {
+    BATCH_ELEMENT_COUNT,
+    BATCH_ACCUMULATED_ELEMENT_COUNT,
+    BATCH_ACCUMULATED_ELEMENT_COUNT_WITH_ZERO,
+    BATCH_MAX_ELEMENT_COUNT_AS_SHAPE
+  };
+
+  Kind kind;
+  std::string target_name;
+  TRITONSERVER_DataType data_type;
+  std::string source_input;
+};
+
+//
+// PackedInput
+//
+// An input whose data for all the requests in the batch is stored back to
+// back in a single shared memory buffer.
+//
+struct PackedInput {
+  TRITONSERVER_DataType dtype;
+  off_t buffer_offset;
+  uint64_t total_byte_size;
+
+  // Shape, offset within the buffer and byte size of the input in each
+  // request.
+  std::vector<std::vector<int64_t>> shapes;
+  std::vector<uint64_t> byte_offsets;
+  std::vector<uint64_t> byte_sizes;
+};
+
+//
+// StaticTensor
+//
+// An input or output whose dims in the model configuration are all fixed.
+//
+struct StaticTensor {
+  std::string name;
+  std::vector<int64_t> dims;
+};
+
+//
+// StaticTensorSlot
+//
+// Name and dims of a StaticTensor that are allocated once in the shared
+// memory and reused by every request.
+//
+struct StaticTensorSlot {
+  off_t name;
+
+  // dims[b] holds the dims for a batch of size 'b'. Only dims[0] is used for
+  // models that don't support batching.
+  std::vector<off_t> dims;
+  std::vector<int64_t> config_dims;
+};
+
+//
+// DtypeConversion
+//
+// Data type of a tensor in the model configuration and the data type used
+// by the Python model, set by the 'PYTHON_DTYPE_<tensor name>' parameter.
+//
+struct DtypeConversion {
+  TRITONSERVER_DataType config_dtype;
+  TRITONSERVER_DataType python_dtype;
+};
+
+//
+// WarmupInput
+//
+// An input of the synthetic requests that warm up the stub processes.
+//
+struct WarmupInput {
+  std::string name;
+  TRITONSERVER_DataType dtype;  // Data type used by the Python model
+  std::vector<int64_t> dims;    // Including the batch dimension, if any
 };
 
+//
+// InstanceSetup
+//
+// Result of the creation of the stub processes of a model instance in the
+// background, nullptr on success.
+//
+using InstanceSetup = std::shared_future<std::shared_ptr<TRITONSERVER_Error>>;
+
 class ModelState : public BackendModel {
  public:
   static TRITONSERVER_Error* Create(
@@ -195,10 +322,209 @@ class ModelState : public BackendModel {
   // Get the Python execution environment
   std::string PythonExecutionEnv() { return python_execution_env_; }
 
+  // Names of the inputs that allow ragged batching
+  const std::set<std::string>& RaggedInputs() { return ragged_inputs_; }
+
+  // Batch inputs that must be generated for each batch
+  const std::vector<BatchInput>& BatchInputs() { return batch_inputs_; }
+
+  // Inputs and outputs with fixed dims
+  const std::vector<StaticTensor>& StaticTensors() { return static_tensors_; }
+
+  // Whether the model uses the decoupled transaction policy, i.e. sends any
+  // number of responses for each request.
+  bool IsDecoupled() { return decoupled_; }
+
+  // Number of threads of the stub that execute the requests of a batch
+  // concurrently.
+  int64_t ExecuteThreadCount() { return execute_thread_count_; }
+
+  // Number of stub processes of each model instance
+  int64_t StubProcessCount() { return stub_process_count_; }
+
+  // Time limit for executing a batch of 'batch_size' elements, in
+  // milliseconds, set by the 'EXECUTE_TIMEOUT_MS' and
+  // 'EXECUTE_TIMEOUT_PER_ITEM_MS' parameters. 0 if there is no limit.
+  int64_t ExecuteTimeoutMs(const size_t batch_size)
+  {
+    return execute_timeout_ms_ + execute_timeout_per_item_ms_ * batch_size;
+  }
+
+  // Count a batch that has exceeded its time limit, and return the number of
+  // such batches of the model so far.
+  uint64_t AddExecuteTimeout() { return ++execute_timeout_count_; }
+
+  // Number of requests of each batch of synthetic requests that warms up a
+  // stub process once it is initialized, set by the 'WARMUP_BATCH_SIZES'
+  // parameter. Each batch is executed 'WarmupRepeatCount()' times.
+  const std::vector<int64_t>& WarmupBatchSizes() { return warmup_batch_sizes_; }
+  int64_t WarmupRepeatCount() { return warmup_repeat_count_; }
+
+  // Inputs and requested outputs of the synthetic requests
+  const std::vector<WarmupInput>& WarmupInputs() { return warmup_inputs_; }
+  const std::vector<std::string>& WarmupOutputs() { return warmup_outputs_; }
+
+  // Whether each model instance keeps an initialized stub process that
+  // replaces the first of its stub processes to fail, set by the
+  // 'STANDBY_STUB_PROCESS' parameter.
+  bool StandbyStubProcess() { return standby_stub_process_; }
+
+  // Whether the requests that a failed stub process has not responded to are
+  // executed again, set by the 'REPLAY_ON_STUB_FAILURE' parameter. Only safe
+  // if the model is idempotent.
+  bool ReplayOnStubFailure() { return replay_on_stub_failure_; }
+
+  // Whether the model instances are initialized concurrently, set by the
+  // 'PARALLEL_INSTANCE_INITIALIZATION' parameter.
+  bool ParallelInstanceInitialization()
+  {
+    return parallel_instance_initialization_;
+  }
+
+  // Add the 'setup' of a model instance initialized concurrently. Once the
+  // setups of all the instances of the model have been added, returns the
+  // ones that must be waited for before the model is ready, and an empty
+  // vector otherwise.
+  std::vector<InstanceSetup> AddInstanceSetup(const InstanceSetup& setup);
+
+  // Whether the stub processes are forked from a zygote, set by the
+  // 'ZYGOTE_PRELOAD_MODULES' and 'ZYGOTE_PREINITIALIZE_HOOK' parameters.
+  bool UsesZygote() { return uses_zygote_; }
+
+  // Fork a stub process with the arguments 'stub_args' from the zygote of
+  // the model. The zygote is spawned with the same stub executable and the
+  // environment 'envp' on first use, and again if it has exited.
+  TRITONSERVER_Error* ForkStubProcess(
+      const std::vector<std::string>& stub_args, char** envp, pid_t* pid);
+
+  // Whether the stubs of the model run in the stub process shared by the
+  // models with the same execution environment, set by the
+  // 'SHARED_STUB_PROCESS' parameter.
+  bool UsesSharedStub() { return uses_shared_stub_; }
+
+  // Whether the model instances of a new version of the model take over the
+  // running stub processes of the previous version, which reload the model
+  // in place, set by the 'HOT_RELOAD' parameter.
+  bool HotReload() { return hot_reload_; }
+
+  // Start a stub with the arguments 'stub_args' in the shared stub process of
+  // the execution environment of the model, and set 'pid' to the pid of that
+  // process. It is spawned with the same stub executable and the environment
+  // 'envp' on first use, and again if it has exited. 'key' and 'generation'
+  // are set to identify that process for SignalSharedStub.
+  TRITONSERVER_Error* StartSharedStub(
+      const std::vector<std::string>& stub_args, char** envp, pid_t* pid,
+      std::string* key, uint64_t* generation);
+
+  // Send 'signum' to the shared stub process 'key' if it is still the one
+  // numbered 'generation', and return whether it was sent. A replaced or
+  // exited process is never signaled, since its pid may have been reused.
+  // A signal of 0 only checks that the process is running, and SIGKILL also
+  // waits for the process to exit.
+  bool SignalSharedStub(
+      const std::string& key, const uint64_t generation, const int signum);
+
+  // Inputs and outputs that are converted to or from the data type used by
+  // the Python model, indexed by name.
+  const std::unordered_map<std::string, DtypeConversion>& InputConversions()
+  {
+    return input_conversions_;
+  }
+  const std::unordered_map<std::string, DtypeConversion>& OutputConversions()
+  {
+    return output_conversions_;
+  }
+
  private:
   ModelState(TRITONBACKEND_Model* triton_model);
+
+  // Parse 'allow_ragged_batch' and 'batch_input' from the model
+  // configuration.
+  TRITONSERVER_Error* ParseRaggedBatchConfig();
+
+  // Find the inputs and outputs that have fixed dims in the model
+  // configuration.
+  TRITONSERVER_Error* ParseStaticTensorConfig();
+
+  // Parse the 'PYTHON_DTYPE_<tensor name>' parameters.
+  TRITONSERVER_Error* ParseDtypeConversionConfig();
+
+  // Parse the parameter 'key', which must be a positive integer, to 'count'.
+  // 'count' is 1 if the parameter is not set.
+  TRITONSERVER_Error* ParseCountParameter(const char* key, int64_t* count);
+
+  // Parse the parameter 'key', which must be a non-negative number of
+  // milliseconds, to 'milliseconds'. 'milliseconds' is 0 if the parameter is
+  // not set.
+  TRITONSERVER_Error* ParseMillisecondsParameter(
+      const char* key, int64_t* milliseconds);
+
+  // Parse the 'WARMUP_*' parameters. Must be called after the data type
+  // conversions are parsed.
+  TRITONSERVER_Error* ParseWarmupConfig();
+
+  // Parse 'value', a comma-separated list of integers, of the parameter 'key'
+  // to 'list'.
+  TRITONSERVER_Error* ParseIntList(
+      const std::string& key, const std::string& value,
+      std::vector<int64_t>* list);
+
+  // Parse the parameter 'key', which must be "true" or "false", to 'value'.
+  // 'value' is false if the parameter is not set.
+  TRITONSERVER_Error* ParseBoolParameter(const char* key, bool* value);
+
+  // Get the number of model instances in the instance groups of the model
+  // configuration.
+  TRITONSERVER_Error* ConfiguredInstanceCount(size_t* instance_count);
+
+  // Parse the 'ZYGOTE_PRELOAD_MODULES' and 'ZYGOTE_PREINITIALIZE_HOOK'
+  // parameters.
+  void ParseZygoteConfig();
+
   BackendState* backend_state_;
   std::string python_execution_env_;
+  bool decoupled_;
+  int64_t execute_thread_count_;
+  int64_t stub_process_count_;
+  int64_t execute_timeout_ms_;
+  int64_t execute_timeout_per_item_ms_;
+  std::atomic<uint64_t> execute_timeout_count_;
+  std::vector<int64_t> warmup_batch_sizes_;
+  int64_t warmup_repeat_count_;
+  std::vector<WarmupInput> warmup_inputs_;
+  std::vector<std::string> warmup_outputs_;
+  bool standby_stub_process_;
+  bool replay_on_stub_failure_;
+  bool parallel_instance_initialization_;
+
+  // The setups of the model instances that are not waited for yet, and the
+  // number of instances whose setup has been added. Protected by
+  // 'instance_setup_mutex_'.
+  std::vector<InstanceSetup> pending_instance_setups_;
+  size_t added_instance_setup_count_;
+  size_t instance_count_;
+  std::mutex instance_setup_mutex_;
+  bool uses_zygote_;
+  bool uses_shared_stub_;
+  bool hot_reload_;
+  std::string zygote_preload_modules_;
+  std::string zygote_preinitialize_hook_;
+  std::unique_ptr<StubZygote> zygote_;
+  std::mutex zygote_mutex_;
+  std::set<std::string> ragged_inputs_;
+  std::vector<BatchInput> batch_inputs_;
+  std::vector<StaticTensor> static_tensors_;
+  std::unordered_map<std::string, DtypeConversion> input_conversions_;
+  std::unordered_map<std::string, DtypeConversion> output_conversions_;
+};
+
+struct ResponseFactoryDeleter {
+  void operator()(TRITONBACKEND_ResponseFactory* factory)
+  {
+    LOG_IF_ERROR(
+        TRITONBACKEND_ResponseFactoryDelete(factory),
+        "failed deleting response factory");
+  }
 };
 
 TRITONSERVER_Error*
@@ -208,11 +534,57 @@ CreateTritonErrorFromException(const PythonBackendException& pb_exception)
       TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
 }
 
-class ModelInstanceState : public BackendModelInstance {
-  ModelInstanceState(
-      ModelState* model_state, TRITONBACKEND_ModelInstance* model_instance);
+// Returns true if 'pid' has exited but has not been reaped by its parent yet.
+bool
+IsZombieProcess(const pid_t pid)
+{
+  std::string stat_path = "/proc/" + std::to_string(pid) + "/stat";
+  FILE* stat_file = fopen(stat_path.c_str(), "r");
+  if (stat_file == nullptr) {
+    return false;
+  }
+  char stat[512];
+  size_t stat_size = fread(stat, 1, sizeof(stat) - 1, stat_file);
+  fclose(stat_file);
+  stat[stat_size] = '\0';
+
+  // The state follows the command name, which is in parentheses and can
+  // contain any character.
+  const char* name_end = strrchr(stat, ')');
+  return (name_end != nullptr) && (name_end[1] == ' ') && (name_end[2] == 'Z');
+}
+
+// Name of the shared memory region of the stub process at 'index' of
+// 'model_instance'. The first stub process keeps the name of the shared
+// memory region used when there is a single one.
+std::string
+StubShmRegionName(BackendModelInstance* model_instance, const size_t index)
+{
+  std::string kind =
+      TRITONSERVER_InstanceGroupKindString(model_instance->Kind());
+  std::string shm_region_name = std::string("/") + model_instance->Name() +
+                                "_" + kind + "_" +
+                                std::to_string(model_instance->DeviceId());
+  if (index != 0) {
+    shm_region_name += "_" + std::to_string(index);
+  }
+  return shm_region_name;
+}
+
+//
+// StubProcess
+//
+// A stub process that runs the Python model of a model instance, along with
+// the shared memory used to exchange the requests and the responses with it.
+// A model instance has one or more stub processes.
+//
+class StubProcess {
+  BackendModelInstance* model_instance_;
+
+  // Index of the stub process in the model instance
+  size_t index_;
+  std::string shm_region_name_;
 
-  TRITONBACKEND_Model* triton_model_;
   bi::interprocess_mutex* stub_mutex_;
   bi::interprocess_condition* stub_cond_;
   bi::interprocess_mutex* parent_mutex_;
@@ -223,23 +595,58 @@ class ModelInstanceState : public BackendModelInstance {
   IPCMessage* ipc_message_;
   std::unique_ptr<SharedMemory> shm_pool_;
 
+  // Offset of the shared memory pool before the stub process is first
+  // started. What is allocated after it belongs to a single stub process.
+  off_t shm_base_offset_;
+
   // Stub process pid
   pid_t stub_pid_;
 
+  // Whether the stub process has been forked from the zygote of the model,
+  // in which case it is not a child of this process.
+  bool forked_;
+
+  // Whether the stub runs in a shared stub process, which also runs the stubs
+  // of other models. Killing it kills these stubs too, so the stub is stopped
+  // on its own instead, see StopSharedStub. The shared stub process is
+  // identified by its key and generation in the model state, since
+  // 'stub_pid_' is only valid as long as that process has not been replaced.
+  bool shared_;
+  std::string shared_stub_key_;
+  uint64_t shared_stub_generation_;
+
   // Parent process pid
   pid_t parent_pid_;
   bool initialized_;
 
-  // Path to python execution environment
-  std::string path_to_libpython_;
-  std::string path_to_activate_;
+  // Environment variables of the stub process, "NAME=value". Empty if the
+  // stub process inherits the environment of this process.
+  std::vector<std::string> stub_env_;
+
+  // Shared memory slots of the tensors with fixed dims, indexed by name and
+  // by the offset of the name.
+  std::unordered_map<std::string, StaticTensorSlot> static_tensor_slots_;
+  std::unordered_map<off_t, std::string> static_tensor_names_;
+
+  // Held while a batch of requests is executed, so that the model is only
+  // reloaded between batches, and protects 'model_instance_'. A stub process
+  // taken over by the next version of the model is shared with the model
+  // instance of the previous version, 'previous_instance_', until it is
+  // deleted.
+  std::mutex batch_mu_;
+  BackendModelInstance* previous_instance_;
 
  public:
-  static TRITONSERVER_Error* Create(
-      ModelState* model_state, TRITONBACKEND_ModelInstance* model_instance,
-      ModelInstanceState** model_instance_state);
+  StubProcess(BackendModelInstance* model_instance, size_t index);
+  ~StubProcess();
 
-  ~ModelInstanceState();
+  const std::string& Name() const { return model_instance_->Name(); }
+  BackendModel* Model() const { return model_instance_->Model(); }
+  TRITONBACKEND_ModelInstance* TritonModelInstance()
+  {
+    return model_instance_->TritonModelInstance();
+  }
+  cudaStream_t CudaStream() { return model_instance_->CudaStream(); }
 
   // Load Triton inputs to the appropriate Protobufs
   TRITONSERVER_Error* GetInputTensor(
@@ -247,8 +654,90 @@ class ModelInstanceState : public BackendModelInstance {
       TRITONBACKEND_Request* request,
       std::vector<TRITONBACKEND_Response*>& responses);
 
+  // Collect the input named 'input_name' of all the requests into a single
+  // shared memory buffer. 'packed' is set to false if the input can't be
+  // packed, e.g. because it is missing in one of the requests. Unless
+  // 'ragged' is true, the input is only packed if all the dimensions except
+  // the first one match.
+  TRITONSERVER_Error* PackInputTensor(
+      const std::string& input_name, const bool ragged,
+      TRITONBACKEND_Request** requests,
+      const uint32_t request_count,
+      std::vector<TRITONBACKEND_Response*>& responses,
+      PackedInput* packed_input, bool* packed);
+
+  // Copy all the buffers of input 'in' to 'dst' in the shared memory with the
+  // copy engine. 'copied' is set to false, and nothing is copied, if some of
+  // the buffers are not in the CPU memory.
+  TRITONSERVER_Error* CopyInput(
+      TRITONBACKEND_Input* in, char* dst, bool* copied);
+
+  // Copy all the buffers of input 'in' to 'dst' in the shared memory,
+  // converting the elements from 'src_dtype' to 'dst_dtype'.
+  TRITONSERVER_Error* CopyInputConverted(
+      TRITONBACKEND_Input* in, TRITONSERVER_DataType src_dtype,
+      TRITONSERVER_DataType dst_dtype, char* dst);
+
+  // Save the packed inputs and the generated batch inputs as the tensors
+  // shared by all the requests in 'request_batch'.
+  TRITONSERVER_Error* SaveBatchInputs(
+      RequestBatch* request_batch, TRITONBACKEND_Request** requests,
+      const uint32_t request_count,
+      const std::unordered_map<std::string, PackedInput>& packed_inputs);
+
+  // Execute 'requests'. If the stub process fails, it is restarted and the
+  // requests are sent an error, unless 'unfinished_requests' is not nullptr.
+  // In that case the stub process is left exited, and the requests that have
+  // not received any response are added to 'unfinished_requests' instead.
   TRITONSERVER_Error* ProcessRequests(
-      TRITONBACKEND_Request** requests, const uint32_t request_count);
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      std::vector<TRITONBACKEND_Request*>* unfinished_requests = nullptr);
+
+  // Whether the stub process has exited and has not been restarted.
+  bool HasExited() const { return stub_pid_ == 0; }
+
+  const std::string& ShmRegionName() const { return shm_region_name_; }
+
+  // Whether the stub process can be taken over by 'model_instance', a model
+  // instance of the next version of the model. The stub process must have
+  // been started with the same arguments and environment.
+  bool CanReload(BackendModelInstance* model_instance);
+
+  // Make the stub process serve 'model_instance' from now on. The stub
+  // imports the model of its version and initializes it, and then replaces
+  // the current model with it once the batch in flight is done. The current
+  // model keeps serving if the new one fails to initialize.
+  TRITONSERVER_Error* Reload(BackendModelInstance* model_instance);
+
+  // Stop using the stub process for 'model_instance', which is being
+  // deleted. A stub process that has been taken over by the next version
+  // keeps running. If the next version is deleted first, e.g. because it has
+  // failed to load, the stub process is restarted for the previous one.
+  void Release(BackendModelInstance* model_instance);
+
+  // Move the stub process to the slot 'index' of its model instance. The
+  // shared memory region keeps its name.
+  void SetIndex(const size_t index) { index_ = index; }
+
+  // Send the response of request 'r', which the stub has completed in
+  // 'response_shm', with 'flags'. 'responses[r]' is set to nullptr once it is
+  // sent. Returns true if the response was sent without an error. Errors are
+  // always sent as final responses.
+  bool SendResponse(
+      TRITONBACKEND_Request* request, Response* response_shm,
+      std::vector<TRITONBACKEND_Response*>& responses, const uint32_t r,
+      const uint32_t flags = TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+
+  // Send a response of a decoupled model for request 'r'. 'response_shm' is
+  // nullptr if only 'flags' are sent. The final response is sent with
+  // 'responses[r]' and the other ones are created from 'factory'.
+  // 'succeeded[r]' is set to true if the final response is sent without an
+  // error.
+  void SendDecoupledResponse(
+      TRITONBACKEND_Request* request, TRITONBACKEND_ResponseFactory* factory,
+      const uint32_t flags, Response* response_shm,
+      std::vector<TRITONBACKEND_Response*>& responses, const uint32_t r,
+      std::vector<bool>& succeeded);
 
   // Create the stub process.
   TRITONSERVER_Error* SetupStubProcess();
@@ -260,8 +749,14 @@ class ModelInstanceState : public BackendModelInstance {
   // Checks whether the stub process is live
   bool IsStubProcessAlive();
 
-  // Wait for stub notification
-  bool WaitForStubNotification();
+  // Wait for stub notification. Returns false if the stub process is not
+  // healthy, or if 'deadline' has passed.
+  bool WaitForStubNotification(
+      const boost::posix_time::ptime& deadline = boost::posix_time::pos_infin);
+
+  // Make the stub process write the Python stacks of all its threads to its
+  // standard error.
+  void DumpStubStacks();
 
   // Responds to all the requests with an error message.
   void RespondErrorToAllRequests(
@@ -271,36 +766,161 @@ class ModelInstanceState : public BackendModelInstance {
   // Kill stub process
   void KillStubProcess();
 
+  // Stop the stub of a shared stub process without stopping the stubs of the
+  // other models. The shared stub process is killed if the stub does not
+  // stop within the stub timeout, e.g. if it is stuck in native code.
+  void StopSharedStub();
+
+  // Wait until the stub process has exited. Returns false if a forked stub
+  // process is still running after a few seconds.
+  bool WaitForStubExit();
+
   // Start stub process
   TRITONSERVER_Error* StartStubProcess();
+
+  // Save the arguments passed to the 'initialize' function of the model in
+  // the shared memory, and set 'offset' to their offset.
+  TRITONSERVER_Error* SaveInitializeArgs(off_t* offset);
+
+  // Terminate the stub process, giving it a chance to finalize the model.
+  void Terminate();
+
+  // Path to the model file of the version of the model instance.
+  std::string ModelFilePath();
+
+  // Free everything allocated in the shared memory pool for the exited stub
+  // process, before it is restarted. The static tensor slots are allocated
+  // again by StartStubProcess.
+  void ResetSharedMemory() { shm_pool_->SetOffset(shm_base_offset_); }
+
+  // Execute the synthetic warmup requests of the model, and log how long they
+  // take.
+  TRITONSERVER_Error* Warmup();
+
+  // Execute a batch of 'request_count' synthetic warmup requests. The
+  // responses are discarded.
+  TRITONSERVER_Error* ExecuteWarmupBatch(const size_t request_count);
+
+  // Make the stub execute the request batch at 'request_batch_offset', and
+  // wait until it is done. Returns the error of the batch, if any, and sets
+  // 'response_batch' to the batch of responses.
+  TRITONSERVER_Error* RunBatch(
+      const off_t request_batch_offset, ResponseBatch** response_batch);
+
+  // Allocate the names and dims of the tensors with fixed dims. This must be
+  // done every time the stub process is started, since the stub resets the
+  // shared memory pool.
+  TRITONSERVER_Error* SetupStaticTensorSlots();
+
+  // Set the name and dims of 'tensor' to its static slot when 'dims' match the
+  // model configuration. Returns false if there is no matching slot.
+  bool UseStaticTensorSlot(
+      Tensor* tensor, const char* name, const int64_t* dims,
+      size_t dims_count);
+
+  // Save the name, dims and data type of 'tensor', using its static slot if
+  // possible.
+  void SaveTensorMetadata(
+      Tensor* tensor, const char* name, const int64_t* dims,
+      size_t dims_count, TRITONSERVER_DataType dtype);
 };
 
-ModelInstanceState::ModelInstanceState(
-    ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance)
-    : BackendModelInstance(model_state, triton_model_instance), stub_pid_(0),
-      initialized_(false)
-{
-}
+//
+// ModelInstanceState
+//
+// State associated with a model instance. The requests of the model instance
+// are executed by its stub processes. With several stub processes, each batch
+// is split by request across the idle ones, and the requests are released by
+// the thread of the stub process that executes them, so that the next batch
+// can be dispatched to the other stub processes in the meantime.
+//
+class ModelInstanceState : public BackendModelInstance {
+ public:
+  static TRITONSERVER_Error* Create(
+      ModelState* model_state, TRITONBACKEND_ModelInstance* model_instance,
+      ModelInstanceState** model_instance_state);
 
-TRITONSERVER_Error*
-ModelInstanceState::Create(
-    ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance,
-    ModelInstanceState** state)
+  ~ModelInstanceState();
+
+  // Create the stub processes.
+  TRITONSERVER_Error* SetupStubProcesses();
+
+  // Start creating the stub processes in the background, and get the result.
+  InstanceSetup StartSetup();
+
+  // Execute 'requests'. With a single stub process the requests are executed
+  // by the calling thread, which must release them. Otherwise they are
+  // dispatched to the stub processes, which release them, and 'released' is
+  // set to true.
+  TRITONSERVER_Error* ProcessRequests(
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      bool* released);
+
+ private:
+  ModelInstanceState(
+      ModelState* model_state, TRITONBACKEND_ModelInstance* model_instance);
+
+  // Execute the requests dispatched to the stub process at 'index' until the
+  // model instance is deleted.
+  void StubThreadLoop(size_t index);
+
+  // Execute 'requests' with the stub process at 'index'. If the stub process
+  // fails, it is replaced by the standby stub process, or restarted if there
+  // is none, and the requests it has not responded to are replayed if the
+  // model allows it.
+  TRITONSERVER_Error* ExecuteRequests(
+      const size_t index, TRITONBACKEND_Request** requests,
+      const uint32_t request_count);
+
+  // Replace the exited stub process at 'index' with the standby stub process,
+  // and start rebuilding a standby stub process from it in the background.
+  // The stub process is restarted in place if the standby one is not ready.
+  void ReplaceStubProcess(const size_t index);
+
+  // Restart the exited stub process 'standby' and make it the standby stub
+  // process. Failed restarts are retried with an exponential backoff until
+  // the model instance is deleted.
+  void RebuildStandby(std::shared_ptr<StubProcess> standby);
+
+  // Take over the stub process at 'index' of the same model instance of the
+  // previous version of the model, if it uses 'HOT_RELOAD' and the stub
+  // process can be reloaded with this version. Returns false otherwise.
+  bool TakeOverStubProcess(const size_t index);
+
+  // The stub processes are shared with the model instance of the previous
+  // version of the model once this one has taken them over.
+  std::vector<std::shared_ptr<StubProcess>> stubs_;
+
+  // Initialized stub process that replaces the first stub process to fail.
+  // nullptr while it is being rebuilt, or if the model does not use one.
+  // Protected by 'standby_mu_', like 'standby_thread_' that rebuilds it.
+  std::shared_ptr<StubProcess> standby_;
+  std::thread standby_thread_;
+  std::mutex standby_mu_;
+
+  // Creation of the stub processes started by StartSetup. Not valid if they
+  // have been created synchronously.
+  InstanceSetup setup_;
+
+  // The requests dispatched to each stub process. A stub process is idle
+  // when it has no requests. Protected by 'mu_'.
+  std::vector<std::vector<TRITONBACKEND_Request*>> dispatched_requests_;
+  std::vector<std::thread> stub_threads_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool exiting_;
+};
+
+StubProcess::StubProcess(BackendModelInstance* model_instance, size_t index)
+    : model_instance_(model_instance), index_(index), stub_pid_(0),
+      forked_(false), shared_(false), shared_stub_generation_(0),
+      initialized_(false), previous_instance_(nullptr)
 {
-  try {
-    *state = new ModelInstanceState(model_state, triton_model_instance);
-  }
-  catch (const BackendModelInstanceException& ex) {
-    RETURN_ERROR_IF_TRUE(
-        ex.err_ == nullptr, TRITONSERVER_ERROR_INTERNAL,
-        std::string("unexpected nullptr in BackendModelInstanceException"));
-    RETURN_IF_ERROR(ex.err_);
-  }
-  return nullptr;  // success
+  shm_region_name_ = StubShmRegionName(model_instance_, index_);
 }
 
 bool
-ModelInstanceState::NotifyStub()
+StubProcess::NotifyStub()
 {
   boost::posix_time::ptime timeout =
       boost::get_system_time() + boost::posix_time::milliseconds(1000);
@@ -315,16 +935,94 @@ ModelInstanceState::NotifyStub()
 }
 
 void
-ModelInstanceState::KillStubProcess()
+StubProcess::KillStubProcess()
 {
-  kill(stub_pid_, SIGKILL);
-  int status;
-  waitpid(stub_pid_, &status, 0);
+  if (shared_) {
+    StopSharedStub();
+  } else {
+    kill(stub_pid_, SIGKILL);
+    WaitForStubExit();
+  }
   stub_pid_ = 0;
 }
 
+void
+StubProcess::StopSharedStub()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  const boost::posix_time::ptime deadline =
+      boost::get_system_time() +
+      boost::posix_time::seconds(
+          model_state->StateForBackend()->stub_timeout_seconds);
+
+  // The stub clears the abort request once it has stopped. The health mutex
+  // may be held by a stuck stub, so it is only waited for a short while.
+  bool requested = false;
+  bool stopped = false;
+  while (!stopped && boost::get_system_time() < deadline &&
+         model_state->SignalSharedStub(
+             shared_stub_key_, shared_stub_generation_, 0)) {
+    {
+      bi::scoped_lock<bi::interprocess_mutex> lock(
+          *health_mutex_,
+          boost::get_system_time() + boost::posix_time::milliseconds(100));
+      if (lock) {
+        if (!requested) {
+          ipc_message_->abort = true;
+          requested = true;
+        } else {
+          stopped = !ipc_message_->abort;
+        }
+      }
+    }
+    if (!stopped) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  if (!stopped && model_state->SignalSharedStub(
+                      shared_stub_key_, shared_stub_generation_, SIGKILL)) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_ERROR,
+        (std::string("Killed the shared stub process, since the stub of "
+                     "model instance ") +
+         Name() + " did not stop.")
+            .c_str());
+  }
+}
+
+bool
+StubProcess::WaitForStubExit()
+{
+  int status;
+  if (!forked_) {
+    waitpid(stub_pid_, &status, 0);
+    return true;
+  }
+
+  // A forked stub process is reaped by the zygote. If the zygote has exited,
+  // the stub is reparented to init, which can be this process when it runs as
+  // PID 1 in a container, and nobody else reaps it. A zombie has exited all
+  // the same.
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((waitpid(stub_pid_, &status, WNOHANG) != stub_pid_) &&
+         (kill(stub_pid_, 0) == 0) && !IsZombieProcess(stub_pid_)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_ERROR,
+          (std::string("Stub process ") + std::to_string(stub_pid_) +
+           " did not exit.")
+              .c_str());
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
 bool
-ModelInstanceState::WaitForStubNotification()
+StubProcess::WaitForStubNotification(const boost::posix_time::ptime& deadline)
 {
   uint64_t timeout_seceonds = 1000;
   boost::posix_time::ptime timeout =
@@ -344,21 +1042,41 @@ ModelInstanceState::WaitForStubNotification()
     }
   }
 
-  timeout = boost::get_system_time() +
-            boost::posix_time::milliseconds(timeout_seceonds);
+  timeout = std::min(
+      deadline, boost::get_system_time() +
+                    boost::posix_time::milliseconds(timeout_seceonds));
   while (!parent_cond_->timed_wait(*parent_lock_, timeout)) {
-    if (!IsStubProcessAlive()) {
+    if (!IsStubProcessAlive() || boost::get_system_time() >= deadline) {
       return false;
     }
 
-    timeout = boost::get_system_time() +
-              boost::posix_time::milliseconds(timeout_seceonds);
+    timeout = std::min(
+        deadline, boost::get_system_time() +
+                      boost::posix_time::milliseconds(timeout_seceonds));
   }
   return true;
 }
 
 void
-ModelInstanceState::RespondErrorToAllRequests(
+StubProcess::DumpStubStacks()
+{
+  // The stub registers faulthandler for SIGUSR1, which writes the stacks from
+  // the signal handler, even if a thread holds the GIL.
+  bool signaled;
+  if (shared_) {
+    ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+    signaled = model_state->SignalSharedStub(
+        shared_stub_key_, shared_stub_generation_, SIGUSR1);
+  } else {
+    signaled = (kill(stub_pid_, SIGUSR1) == 0);
+  }
+  if (signaled) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+void
+StubProcess::RespondErrorToAllRequests(
     const char* message, std::vector<TRITONBACKEND_Response*>& responses,
     TRITONBACKEND_Request** requests, const uint32_t request_count)
 {
@@ -383,9 +1101,11 @@ ModelInstanceState::RespondErrorToAllRequests(
 }
 
 TRITONSERVER_Error*
-ModelInstanceState::ProcessRequests(
-    TRITONBACKEND_Request** requests, const uint32_t request_count)
+StubProcess::ProcessRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::vector<TRITONBACKEND_Request*>* unfinished_requests)
 {
+  std::lock_guard<std::mutex> lock(batch_mu_);
   ModelState* model_state = reinterpret_cast<ModelState*>(Model());
   int max_batch_size = model_state->MaxBatchSize();
   std::string name = model_state->Name();
@@ -468,6 +1188,7 @@ ModelInstanceState::ProcessRequests(
 
   ipc_message_->request_batch = request_batch_offset;
   request_batch->batch_size = request_count;
+  request_batch->batch_input_count = 0;
 
   Request* requests_shm;
   off_t requests_shm_offset;
@@ -492,6 +1213,57 @@ ModelInstanceState::ProcessRequests(
     }
   }
 
+  // Decoupled models can send several responses for each request. The
+  // responses other than the final one are created from a response factory.
+  std::vector<std::unique_ptr<
+      TRITONBACKEND_ResponseFactory, ResponseFactoryDeleter>>
+      response_factories;
+  if (model_state->IsDecoupled()) {
+    for (size_t i = 0; i < request_count; i++) {
+      TRITONBACKEND_ResponseFactory* factory;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          &responses, request_count,
+          TRITONBACKEND_ResponseFactoryNew(&factory, requests[i]));
+      response_factories.emplace_back(factory);
+    }
+  }
+
+  // The same input of all the requests is placed back to back in a single
+  // buffer so that the model can process the whole batch at once. Ragged
+  // inputs are always packed. The other inputs are packed when there is more
+  // than one request and all of them have the same data type and the same
+  // dimensions except for the first one.
+  std::set<std::string> input_names = model_state->RaggedInputs();
+  if (request_count > 1) {
+    uint32_t input_count = 0;
+    RESPOND_ALL_AND_RETURN_IF_ERROR(
+        &responses, request_count,
+        TRITONBACKEND_RequestInputCount(requests[0], &input_count));
+    for (uint32_t i = 0; i < input_count; ++i) {
+      const char* input_name;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          &responses, request_count,
+          TRITONBACKEND_RequestInputName(requests[0], i, &input_name));
+      input_names.insert(input_name);
+    }
+  }
+
+  std::unordered_map<std::string, PackedInput> packed_inputs;
+  for (const auto& input_name : input_names) {
+    const bool ragged = model_state->RaggedInputs().find(input_name) !=
+                        model_state->RaggedInputs().end();
+    PackedInput packed_input;
+    bool packed = false;
+    RESPOND_ALL_AND_RETURN_IF_ERROR(
+        &responses, request_count,
+        PackInputTensor(
+            input_name, ragged, requests, request_count, responses,
+            &packed_input, &packed));
+    if (packed) {
+      packed_inputs.emplace(input_name, std::move(packed_input));
+    }
+  }
+
   for (uint32_t r = 0; r < request_count; ++r) {
     TRITONBACKEND_Request* request = requests[r];
     Request* python_infer_request = &requests_shm[r];
@@ -521,6 +1293,30 @@ ModelInstanceState::ProcessRequests(
     for (size_t iidx = 0; iidx < requested_input_count; ++iidx) {
       Tensor* input_tensor = &input_tensors[iidx];
 
+      const char* input_name;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          &responses, request_count,
+          TRITONBACKEND_RequestInputName(request, iidx, &input_name));
+
+      // Packed inputs only need to point to their part of the packed buffer.
+      auto packed_input = packed_inputs.find(input_name);
+      if (packed_input != packed_inputs.end()) {
+        const PackedInput& packed = packed_input->second;
+        RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
+            &responses, request_count,
+            SaveRawDataViewToSharedMemory(
+                shm_pool_, input_tensor->raw_data,
+                packed.buffer_offset + packed.byte_offsets[r],
+                TRITONSERVER_MEMORY_CPU /* memory_type */,
+                0 /* memory_type_id */, packed.byte_sizes[r]));
+        RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
+            &responses, request_count,
+            SaveTensorMetadata(
+                input_tensor, input_name, packed.shapes[r].data(),
+                packed.shapes[r].size(), packed.dtype));
+        continue;
+      }
+
       RESPOND_ALL_AND_RETURN_IF_ERROR(
           &responses, request_count,
           GetInputTensor(iidx, input_tensor, request, responses));
@@ -546,7 +1342,13 @@ ModelInstanceState::ProcessRequests(
           TRITONBACKEND_RequestOutputName(
               request, iidx, &requested_output_name));
 
-      // output name
+      // output name. The stub reuses this string for the output tensor.
+      auto slot = static_tensor_slots_.find(requested_output_name);
+      if (slot != static_tensor_slots_.end()) {
+        requested_output_names[iidx] = slot->second.name;
+        continue;
+      }
+
       off_t output_name_offset;
       RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
           &responses, request_count,
@@ -573,6 +1375,10 @@ ModelInstanceState::ProcessRequests(
     python_infer_request->correlation_id = correlation_id;
   }
 
+  RESPOND_ALL_AND_RETURN_IF_ERROR(
+      &responses, request_count,
+      SaveBatchInputs(request_batch, requests, request_count, packed_inputs));
+
   uint64_t compute_start_ns = 0;
   SET_TIMESTAMP(compute_start_ns);
 
@@ -588,24 +1394,145 @@ ModelInstanceState::ProcessRequests(
     return nullptr;
   }
 
+  // The stub publishes each response in the completion queue of the response
+  // batch as soon as it is ready, and the response is sent right away while
+  // the stub works on the other ones. The queue is reset before the stub is
+  // notified.
+  ResponseBatch* response_batch;
+  RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
+      &responses, request_count,
+      shm_pool_->MapOffset(
+          (char**)&response_batch, sizeof(ResponseBatch),
+          ipc_message_->response_batch));
+  response_batch->completed_responses = 0;
+  response_batch->batch_done = false;
+  response_batch->responses_released = false;
+
+  // Sent responses are set to nullptr in 'responses'. 'next_completed' points
+  // to the offset of the next entry of the completion queue.
+  std::vector<bool> succeeded(request_count, false);
+  std::vector<bool> responded(request_count, false);
+  off_t* next_completed = &response_batch->completed_responses;
+  const int64_t timeout_ms = model_state->ExecuteTimeoutMs(total_batch_size);
+  boost::posix_time::ptime deadline = boost::posix_time::pos_infin;
+  if (timeout_ms > 0) {
+    deadline = boost::get_system_time() +
+               boost::posix_time::milliseconds(timeout_ms);
+  }
+  bool stub_responding = NotifyStub();
+  while (stub_responding) {
+    off_t completed_offset = __atomic_load_n(next_completed, __ATOMIC_ACQUIRE);
+    if (completed_offset != 0) {
+      // The stub can publish other responses while these are sent.
+      parent_lock_->unlock();
+      do {
+        CompletedResponse* completed;
+        Response* response_shm = nullptr;
+        try {
+          shm_pool_->MapOffset(
+              (char**)&completed, sizeof(CompletedResponse), completed_offset);
+          if (completed->response != 0) {
+            shm_pool_->MapOffset(
+                (char**)&response_shm, sizeof(Response), completed->response);
+          }
+        }
+        catch (const PythonBackendException& pb_exception) {
+          LOG_MESSAGE(TRITONSERVER_LOG_ERROR, pb_exception.what());
+          stub_responding = false;
+          break;
+        }
+
+        const uint32_t r = completed->request_index;
+        responded[r] = true;
+        if (model_state->IsDecoupled()) {
+          SendDecoupledResponse(
+              requests[r], response_factories[r].get(), completed->flags,
+              response_shm, responses, r, succeeded);
+        } else {
+          succeeded[r] = SendResponse(requests[r], response_shm, responses, r);
+        }
+
+        next_completed = &completed->next;
+        completed_offset = __atomic_load_n(next_completed, __ATOMIC_ACQUIRE);
+      } while (completed_offset != 0);
+      parent_lock_->lock();
+      continue;
+    }
+
+    // The flag is set by the stub while holding the parent mutex, so the
+    // notification that comes with it can't be missed.
+    if (response_batch->batch_done) {
+      break;
+    }
+
+    // All the published responses have been sent, so the stub can reuse
+    // their shared memory.
+    if (next_completed != &response_batch->completed_responses) {
+      response_batch->completed_responses = 0;
+      response_batch->responses_released = true;
+      next_completed = &response_batch->completed_responses;
+    }
+    stub_responding = WaitForStubNotification(deadline);
+  }
+
   // If parent fails to notify the stub or the stub fails to notify the
   // parent in a timely manner, kill the stub process and restart the
-  // stub process.
-  if (!NotifyStub() || !WaitForStubNotification()) {
-    KillStubProcess();
+  // stub process. A batch that exceeds its time limit is handled the same
+  // way, once the stacks of the stub have been logged.
+  if (!stub_responding) {
     const char* error_message = "The stub process has exited unexpectedly.";
+    std::string timeout_message;
+    if (boost::get_system_time() >= deadline) {
+      DumpStubStacks();
+      timeout_message =
+          std::string("The execution of ") + std::to_string(request_count) +
+          " requests has exceeded its time limit of " +
+          std::to_string(timeout_ms) + " ms.";
+      error_message = timeout_message.c_str();
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_ERROR,
+          (std::string("Killing the stub process of model instance ") +
+           Name() + ", batch time limit exceeded " +
+           std::to_string(model_state->AddExecuteTimeout()) + " times")
+              .c_str());
+    }
+    KillStubProcess();
     LOG_MESSAGE(TRITONSERVER_LOG_ERROR, error_message);
+    if (unfinished_requests != nullptr) {
+      // The partial responses of decoupled requests can't be taken back, so
+      // only the requests without any response are left to the caller.
+      for (uint32_t r = 0; r < request_count; ++r) {
+        if (responses[r] != nullptr && !responded[r]) {
+          LOG_IF_ERROR(
+              TRITONBACKEND_ResponseDelete(responses[r]),
+              "failed deleting response");
+          responses[r] = nullptr;
+          unfinished_requests->push_back(requests[r]);
+        }
+      }
+      RespondErrorToAllRequests(
+          error_message, responses, requests, request_count);
+      return nullptr;
+    }
+
+    // The request batch and the static tensor slots are dropped along with
+    // the shared memory of the stub process, which the restarted stub process
+    // allocates again.
+    ResetSharedMemory();
     TRITONSERVER_Error* err = StartStubProcess();
     if (err == nullptr) {
       LOG_MESSAGE(
           TRITONSERVER_LOG_INFO, "Stub process successfully restarted.");
+      RespondErrorToAllRequests(
+          error_message, responses, requests, request_count);
+      return nullptr;
     } else {
       LOG_MESSAGE(
           TRITONSERVER_LOG_ERROR,
           (std::string(
                "Stub process failed to restart. Your future requests to "
                "model ") +
-           name_ + " will fail. Error: " + TRITONSERVER_ErrorMessage(err))
+           Name() + " will fail. Error: " + TRITONSERVER_ErrorMessage(err))
               .c_str());
     }
     RespondErrorToAllRequests(
@@ -619,16 +1546,9 @@ ModelInstanceState::ProcessRequests(
   uint64_t compute_end_ns = 0;
   SET_TIMESTAMP(compute_end_ns);
 
-  // Parsing the request response
-  ResponseBatch* response_batch;
-  RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
-      &responses, request_count,
-      shm_pool_->MapOffset(
-          (char**)&response_batch, sizeof(ResponseBatch),
-          ipc_message_->response_batch));
-
   // If inference fails, release all the requests and send an error response. If
-  // inference fails at this stage, it usually indicates a bug in the model code
+  // inference fails at this stage, it usually indicates a bug in the model
+  // code. The responses completed before the failure have already been sent.
   if (response_batch->has_error) {
     if (response_batch->is_error_set) {
       char* error_message;
@@ -648,197 +1568,300 @@ ModelInstanceState::ProcessRequests(
     return nullptr;
   }
 
-  Response* responses_shm;
-  RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
-      &responses, request_count,
-      shm_pool_->MapOffset(
-          (char**)&responses_shm, sizeof(Response) * response_batch->batch_size,
-          response_batch->responses));
-
+  uint64_t exec_end_ns = 0;
+  SET_TIMESTAMP(exec_end_ns);
 
   for (uint32_t r = 0; r < request_count; ++r) {
-    TRITONBACKEND_Response* response = responses[r];
     TRITONBACKEND_Request* request = requests[r];
-    uint32_t requested_output_count = 0;
 
-    // Get response r
-    Response* response_shm = &responses_shm[r];
+    // Report statistics for the request. Note that there could
+    // still be responses that have not yet been sent but those
+    // cannot be captured in the statistics as they reflect only the
+    // request object. We use the execution start/end time for
+    // compute also so that the entire execution time is associated
+    // with the inference computation.
+    LOG_IF_ERROR(
+        TRITONBACKEND_ModelInstanceReportStatistics(
+            TritonModelInstance(), request, succeeded[r] /* success */,
+            exec_start_ns, compute_start_ns, compute_end_ns, exec_end_ns),
+        "failed reporting request statistics");
+  }
 
-    if (response_shm->has_error) {
-      try {
-        if (response_shm->is_error_set) {
-          char* err_string;
-          LoadStringFromSharedMemory(
-              shm_pool_, response_shm->error, err_string);
-          TRITONSERVER_Error* err =
-              TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_string);
+  // Report the entire batch statistics. This backend does not support
+  // batching so the total batch size is always 1.
+  LOG_IF_ERROR(
+      TRITONBACKEND_ModelInstanceReportBatchStatistics(
+          TritonModelInstance(), total_batch_size, exec_start_ns,
+          compute_start_ns, compute_end_ns, exec_end_ns),
+      "failed reporting batch request statistics");
 
-          LOG_IF_ERROR(
-              TRITONBACKEND_ResponseSend(
-                  responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, err),
-              "failed sending response");
-          TRITONSERVER_ErrorDelete(err);
-        } else {
-          const char* err_string = "Failed to process response.";
-          TRITONSERVER_Error* err =
-              TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_string);
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("TRITONBACKEND_ModelInstanceExecute: model instance name ") +
+       Name() + " released " + std::to_string(request_count) + " requests")
+          .c_str());
 
-          LOG_IF_ERROR(
-              TRITONBACKEND_ResponseSend(
-                  responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, err),
-              "failed sending response");
-          TRITONSERVER_ErrorDelete(err);
-        }
-      }
-      catch (const PythonBackendException& pb_exception) {
-        TRITONSERVER_Error* err = CreateTritonErrorFromException(pb_exception);
+  // Update the shared memory offset so that we can reuse the shared memory
+  shm_pool_->SetOffset(request_batch_offset);
+  return nullptr;
+}
+
+bool
+StubProcess::SendResponse(
+    TRITONBACKEND_Request* request, Response* response_shm,
+    std::vector<TRITONBACKEND_Response*>& responses, const uint32_t r,
+    const uint32_t flags)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  TRITONBACKEND_Response* response = responses[r];
+  uint32_t requested_output_count = 0;
+
+  if (response_shm->has_error) {
+    try {
+      if (response_shm->is_error_set) {
+        char* err_string;
+        LoadStringFromSharedMemory(shm_pool_, response_shm->error, err_string);
+        TRITONSERVER_Error* err =
+            TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_string);
 
         LOG_IF_ERROR(
             TRITONBACKEND_ResponseSend(
                 responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, err),
             "failed sending response");
-      }
+        TRITONSERVER_ErrorDelete(err);
+      } else {
+        const char* err_string = "Failed to process response.";
+        TRITONSERVER_Error* err =
+            TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_string);
 
-      responses[r] = nullptr;
+        LOG_IF_ERROR(
+            TRITONBACKEND_ResponseSend(
+                responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, err),
+            "failed sending response");
+        TRITONSERVER_ErrorDelete(err);
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      TRITONSERVER_Error* err = CreateTritonErrorFromException(pb_exception);
 
-      // If has_error is true, we do not look at the response even if the
-      // response is set.
-      continue;
+      LOG_IF_ERROR(
+          TRITONBACKEND_ResponseSend(
+              responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, err),
+          "failed sending response");
     }
 
+    responses[r] = nullptr;
+
+    // If has_error is true, we do not look at the response even if the
+    // response is set.
+    return false;
+  }
+
+  GUARDED_RESPOND_IF_ERROR(
+      responses, r,
+      TRITONBACKEND_RequestOutputCount(request, &requested_output_count));
+
+  // The stub only sends back the outputs that were requested.
+  uint32_t output_count = response_shm->outputs_size;
+  Tensor* output_tensors;
+  GUARDED_RESPOND_IF_EXCEPTION(
+      responses, r,
+      shm_pool_->MapOffset(
+          (char**)&output_tensors, sizeof(Tensor) * output_count,
+          response_shm->outputs));
+
+  bool cuda_copy = false;
+  std::set<std::string> requested_output_names;
+  for (size_t j = 0; j < requested_output_count; ++j) {
+    const char* output_name;
     GUARDED_RESPOND_IF_ERROR(
         responses, r,
-        TRITONBACKEND_RequestOutputCount(request, &requested_output_count));
+        TRITONBACKEND_RequestOutputName(request, j, &output_name));
+    requested_output_names.insert(output_name);
+  }
 
-    Tensor* output_tensors;
+  for (size_t j = 0; j < output_count; ++j) {
+    Tensor* output_tensor = &output_tensors[j];
+    TRITONSERVER_DataType triton_dt = output_tensor->dtype;
+    size_t dims_count = output_tensor->dims_count;
+    int64_t* dims;
     GUARDED_RESPOND_IF_EXCEPTION(
         responses, r,
         shm_pool_->MapOffset(
-            (char**)&output_tensors, sizeof(Tensor) * requested_output_count,
-            response_shm->outputs));
-
-    bool cuda_copy = false;
-    std::set<std::string> requested_output_names;
-    for (size_t j = 0; j < requested_output_count; ++j) {
-      const char* output_name;
-      GUARDED_RESPOND_IF_ERROR(
-          responses, r,
-          TRITONBACKEND_RequestOutputName(request, j, &output_name));
-      requested_output_names.insert(output_name);
-    }
+            (char**)&dims, sizeof(int64_t) * dims_count, output_tensor->dims));
 
-    for (size_t j = 0; j < requested_output_count; ++j) {
-      Tensor* output_tensor = &output_tensors[j];
-      TRITONSERVER_DataType triton_dt = output_tensor->dtype;
-      size_t dims_count = output_tensor->dims_count;
-      int64_t* dims;
+    const char* name;
+    auto static_name = static_tensor_names_.find(output_tensor->name);
+    if (static_name != static_tensor_names_.end()) {
+      name = static_name->second.c_str();
+    } else {
+      char* shm_name;
       GUARDED_RESPOND_IF_EXCEPTION(
           responses, r,
-          shm_pool_->MapOffset(
-              (char**)&dims, sizeof(int64_t) * dims_count,
-              output_tensor->dims));
+          LoadStringFromSharedMemory(shm_pool_, output_tensor->name, shm_name));
+      name = shm_name;
+    }
 
-      char* name;
-      GUARDED_RESPOND_IF_EXCEPTION(
-          responses, r,
-          LoadStringFromSharedMemory(shm_pool_, output_tensor->name, name));
+    // Skip the output tensor if it is not in the list of requested outputs
+    if (requested_output_names.find(std::string(name)) ==
+        requested_output_names.end()) {
+      continue;
+    }
 
-      // Skip the output tensor if it is not in the list of requested outputs
-      if (requested_output_names.find(std::string(name)) ==
-          requested_output_names.end()) {
-        continue;
-      }
+    RawData* raw_data;
+    GUARDED_RESPOND_IF_EXCEPTION(
+        responses, r,
+        shm_pool_->MapOffset(
+            (char**)&raw_data, sizeof(RawData), output_tensor->raw_data));
 
-      RawData* raw_data;
-      GUARDED_RESPOND_IF_EXCEPTION(
-          responses, r,
-          shm_pool_->MapOffset(
-              (char**)&raw_data, sizeof(RawData), output_tensor->raw_data));
+    char* data;
+    GUARDED_RESPOND_IF_EXCEPTION(
+        responses, r,
+        shm_pool_->MapOffset(
+            (char**)&data, raw_data->byte_size, raw_data->memory_ptr));
+
+    // Outputs produced in the Python data type are converted to the data
+    // type in the model configuration while they are copied.
+    uint64_t output_byte_size = raw_data->byte_size;
+    TRITONSERVER_DataType output_dt = triton_dt;
+    auto conversion = model_state->OutputConversions().find(name);
+    const bool convert =
+        (conversion != model_state->OutputConversions().end()) &&
+        (conversion->second.python_dtype == triton_dt);
+    if (convert) {
+      output_dt = conversion->second.config_dtype;
+      output_byte_size = raw_data->byte_size /
+                         TRITONSERVER_DataTypeByteSize(triton_dt) *
+                         TRITONSERVER_DataTypeByteSize(output_dt);
+    }
 
-      char* data;
-      GUARDED_RESPOND_IF_EXCEPTION(
-          responses, r,
-          shm_pool_->MapOffset(
-              (char**)&data, raw_data->byte_size, raw_data->memory_ptr));
+    std::vector<int64_t> batch_shape(dims, dims + dims_count);
+    TRITONSERVER_MemoryType actual_memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t actual_memory_type_id = 0;
+    void* buffer;
+
+    TRITONBACKEND_Output* response_output;
+    GUARDED_RESPOND_IF_ERROR(
+        responses, r,
+        TRITONBACKEND_ResponseOutput(
+            response, &response_output, name, output_dt, batch_shape.data(),
+            batch_shape.size()));
 
-      std::vector<int64_t> batch_shape(dims, dims + dims_count);
-      TRITONSERVER_MemoryType actual_memory_type = TRITONSERVER_MEMORY_CPU;
-      int64_t actual_memory_type_id = 0;
-      void* buffer;
+    bool cuda_used;
+    GUARDED_RESPOND_IF_ERROR(
+        responses, r,
+        TRITONBACKEND_OutputBuffer(
+            response_output, &buffer, output_byte_size, &actual_memory_type,
+            &actual_memory_type_id));
+
+    // CPU output buffers are written directly by the conversion. Other
+    // buffers are converted in a temporary buffer and then copied.
+    bool copied = false;
+    std::vector<char> converted_output;
+    if (convert) {
+      const size_t element_count =
+          raw_data->byte_size / TRITONSERVER_DataTypeByteSize(triton_dt);
+      if ((actual_memory_type == TRITONSERVER_MEMORY_CPU) ||
+          (actual_memory_type == TRITONSERVER_MEMORY_CPU_PINNED)) {
+        ConvertBuffer(data, triton_dt, buffer, output_dt, element_count);
+        copied = true;
+      } else {
+        converted_output.resize(output_byte_size);
+        ConvertBuffer(
+            data, triton_dt, converted_output.data(), output_dt, element_count);
+        data = converted_output.data();
+      }
+    }
 
-      TRITONBACKEND_Output* response_output;
-      GUARDED_RESPOND_IF_ERROR(
-          responses, r,
-          TRITONBACKEND_ResponseOutput(
-              response, &response_output, name, triton_dt, batch_shape.data(),
-              batch_shape.size()));
+    // The output buffer belongs to Triton, which only reads it once the
+    // response is serialized, so large outputs are written around the cache
+    // instead of evicting the tensors of the next batches.
+    if (!copied && ((actual_memory_type == TRITONSERVER_MEMORY_CPU) ||
+                    (actual_memory_type == TRITONSERVER_MEMORY_CPU_PINNED))) {
+      model_state->StateForBackend()->copy_engine->Copy(
+          static_cast<char*>(buffer), data, output_byte_size,
+          true /* non_temporal */);
+      copied = true;
+    }
 
-      bool cuda_used;
-      GUARDED_RESPOND_IF_ERROR(
-          responses, r,
-          TRITONBACKEND_OutputBuffer(
-              response_output, &buffer, raw_data->byte_size,
-              &actual_memory_type, &actual_memory_type_id));
+    if (!copied) {
       CopyBuffer(
           "Failed to copy string", TRITONSERVER_MEMORY_CPU /* memory_type */,
           0 /* memory_type_id */, actual_memory_type, actual_memory_type_id,
-          raw_data->byte_size, data, buffer, CudaStream(), &cuda_used);
+          output_byte_size, data, buffer, CudaStream(), &cuda_used);
       cuda_copy |= cuda_used;
     }
+  }
 #ifdef TRITON_ENABLE_GPU
-    if (cuda_copy) {
-      cudaStreamSynchronize(stream_);
-    }
+  if (cuda_copy) {
+    cudaStreamSynchronize(stream_);
+  }
 #endif  // TRITON_ENABLE_GPU
 
-    // If error happens at this stage, we can only log it
-    LOG_IF_ERROR(
-        TRITONBACKEND_ResponseSend(
-            responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL, nullptr),
-        "failed sending response");
+  if (responses[r] == nullptr) {
+    return false;
   }
 
-  uint64_t exec_end_ns = 0;
-  SET_TIMESTAMP(exec_end_ns);
+  // If error happens at this stage, we can only log it
+  LOG_IF_ERROR(
+      TRITONBACKEND_ResponseSend(responses[r], flags, nullptr),
+      "failed sending response");
+  responses[r] = nullptr;
+  return true;
+}
 
-  for (uint32_t r = 0; r < request_count; ++r) {
-    TRITONBACKEND_Request* request = requests[r];
+void
+StubProcess::SendDecoupledResponse(
+    TRITONBACKEND_Request* request, TRITONBACKEND_ResponseFactory* factory,
+    const uint32_t flags, Response* response_shm,
+    std::vector<TRITONBACKEND_Response*>& responses, const uint32_t r,
+    std::vector<bool>& succeeded)
+{
+  // The request is already complete, e.g. because one of its responses
+  // failed.
+  if (responses[r] == nullptr) {
+    return;
+  }
 
-    // Report statistics for the request. Note that there could
-    // still be responses that have not yet been sent but those
-    // cannot be captured in the statistics as they reflect only the
-    // request object. We use the execution start/end time for
-    // compute also so that the entire execution time is associated
-    // with the inference computation.
+  if ((flags & TRITONSERVER_RESPONSE_COMPLETE_FINAL) != 0) {
+    if (response_shm != nullptr) {
+      succeeded[r] = SendResponse(request, response_shm, responses, r, flags);
+      return;
+    }
+
+    // Only the final flag is sent, so the response created for the errors is
+    // not needed.
     LOG_IF_ERROR(
-        TRITONBACKEND_ModelInstanceReportStatistics(
-            TritonModelInstance(), request,
-            (responses[r] != nullptr) /* success */, exec_start_ns,
-            compute_start_ns, compute_end_ns, exec_end_ns),
-        "failed reporting request statistics");
+        TRITONBACKEND_ResponseDelete(responses[r]),
+        "failed deleting response");
+    responses[r] = nullptr;
+    TRITONSERVER_Error* err =
+        TRITONBACKEND_ResponseFactorySendFlags(factory, flags);
+    succeeded[r] = (err == nullptr);
+    LOG_IF_ERROR(err, "failed sending response flags");
+    return;
   }
 
-  // Report the entire batch statistics. This backend does not support
-  // batching so the total batch size is always 1.
-  LOG_IF_ERROR(
-      TRITONBACKEND_ModelInstanceReportBatchStatistics(
-          TritonModelInstance(), total_batch_size, exec_start_ns,
-          compute_start_ns, compute_end_ns, exec_end_ns),
-      "failed reporting batch request statistics");
-
-  LOG_MESSAGE(
-      TRITONSERVER_LOG_VERBOSE,
-      (std::string("TRITONBACKEND_ModelInstanceExecute: model instance name ") +
-       Name() + " released " + std::to_string(request_count) + " requests")
-          .c_str());
+  std::vector<TRITONBACKEND_Response*> partial_responses(1, nullptr);
+  GUARDED_RESPOND_IF_ERROR(
+      responses, r,
+      TRITONBACKEND_ResponseNewFromFactory(&partial_responses[0], factory));
+  if (responses[r] == nullptr) {
+    return;
+  }
 
-  // Update the shared memory offset so that we can reuse the shared memory
-  shm_pool_->SetOffset(request_batch_offset);
-  return nullptr;
+  // A response that fails is sent as a final error response, which completes
+  // the request.
+  if (!SendResponse(request, response_shm, partial_responses, 0, flags)) {
+    LOG_IF_ERROR(
+        TRITONBACKEND_ResponseDelete(responses[r]),
+        "failed deleting response");
+    responses[r] = nullptr;
+  }
 }
 
 bool
-ModelInstanceState::IsStubProcessAlive()
+StubProcess::IsStubProcessAlive()
 {
   boost::posix_time::ptime timeout =
       boost::get_system_time() + boost::posix_time::seconds(1);
@@ -855,16 +1878,12 @@ ModelInstanceState::IsStubProcessAlive()
 }
 
 TRITONSERVER_Error*
-ModelInstanceState::StartStubProcess()
+StubProcess::StartStubProcess()
 {
   stub_mutex_ = new (stub_mutex_) bi::interprocess_mutex;
   health_mutex_ = new (health_mutex_) bi::interprocess_mutex;
   stub_cond_ = new (stub_cond_) bi::interprocess_condition;
 
-  std::string kind = TRITONSERVER_InstanceGroupKindString(kind_);
-  std::string shm_region_name =
-      std::string("/") + Name() + "_" + kind + "_" + std::to_string(device_id_);
-
   ModelState* model_state = reinterpret_cast<ModelState*>(Model());
   int64_t shm_growth_size =
       model_state->StateForBackend()->shm_growth_byte_size;
@@ -874,167 +1893,585 @@ ModelInstanceState::StartStubProcess()
 
   initialized_ = false;
 
-  pid_t pid = fork();
-  if (pid < 0) {
-    return TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_INTERNAL, "Failed to fork the stub process.");
-  }
+  // Default Python backend stub
+  std::string python_backend_stub =
+      model_state->StateForBackend()->python_lib +
+      "/triton_python_backend_stub";
 
-  // Stub process
-  if (pid == 0) {
-    const char* stub_args[4];
-    stub_args[0] = "bash";
-    stub_args[1] = "-c";
-    stub_args[3] = nullptr;  // Last argument must be nullptr
+  // Path to alternative Python backend stub
+  std::string model_python_backend_stub =
+      std::string(model_path) + "/triton_python_backend_stub";
 
-    // Default Python backend stub
-    std::string python_backend_stub =
-        model_state->StateForBackend()->python_lib +
-        "/triton_python_backend_stub";
+  if (FileExists(model_python_backend_stub)) {
+    python_backend_stub = model_python_backend_stub;
+  }
 
-    // Path to alternative Python backend stub
-    std::string model_python_backend_stub =
-        std::string(model_path) + "/triton_python_backend_stub";
+  std::vector<std::string> stub_args = {
+      python_backend_stub,
+      model_path_,
+      shm_region_name_,
+      std::to_string(shm_default_size),
+      std::to_string(shm_growth_size),
+      std::to_string(parent_pid_),
+      model_state->StateForBackend()->python_lib,
+      std::to_string(model_state->StateForBackend()->copy_thread_count),
+      std::to_string(model_state->StateForBackend()->copy_parallel_byte_size),
+      std::to_string(model_state->ExecuteThreadCount())};
+
+  std::string command_line;
+  for (std::string& stub_arg : stub_args) {
+    command_line += (command_line.empty() ? "" : " ") + stub_arg;
+  }
 
-    if (FileExists(model_python_backend_stub)) {
-      python_backend_stub = model_python_backend_stub;
+  char** envp = environ;
+  std::vector<char*> stub_envp;
+  if (!stub_env_.empty()) {
+    for (std::string& variable : stub_env_) {
+      stub_envp.push_back(&variable[0]);
     }
+    stub_envp.push_back(nullptr);
+    envp = stub_envp.data();
+  }
 
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("Starting Python backend stub: ") + command_line).c_str());
+
+  pid_t pid;
+  shared_ = model_state->UsesSharedStub();
+  forked_ = !shared_ && model_state->UsesZygote();
+  ipc_message_->abort = false;
+  if (shared_) {
+    RETURN_IF_ERROR(model_state->StartSharedStub(
+        stub_args, envp, &pid, &shared_stub_key_, &shared_stub_generation_));
+  } else if (forked_) {
+    RETURN_IF_ERROR(model_state->ForkStubProcess(stub_args, envp, &pid));
+  } else if (int err = SpawnStubProcess(stub_args, envp, nullptr, &pid)) {
     std::stringstream ss;
-    ss << "exec " << python_backend_stub << " " << model_path_ << " "
-       << shm_region_name << " " << shm_default_size << " " << shm_growth_size
-       << " " << parent_pid_ << " "
-       << model_state->StateForBackend()->python_lib;
-
-    std::string bash_argument;
-    bash_argument = ss.str();
-    if (model_state->PythonExecutionEnv() != "") {
-      // Need to properly set the LD_LIBRARY_PATH so that Python environments
-      // using different python versions load properly.
-      bash_argument = "export LD_LIBRARY_PATH=" + path_to_libpython_ +
-                      ":$LD_LIBRARY_PATH; source " + path_to_activate_ +
-                      " && " + bash_argument;
-    }
-    LOG_MESSAGE(
-        TRITONSERVER_LOG_VERBOSE,
-        (std::string("Starting Python backend stub: ") + bash_argument)
+    ss << "Failed to run python backend stub. Errno = " << err << '\n'
+       << "Python backend stub path: " << python_backend_stub << '\n'
+       << "Shared Memory Region Name: " << shm_region_name_ << '\n'
+       << "Shared Memory Default Byte Size: " << shm_default_size << '\n'
+       << "Shared Memory Growth Byte Size: " << shm_growth_size << '\n';
+    std::string log_message = ss.str();
+    LOG_MESSAGE(TRITONSERVER_LOG_ERROR, log_message.c_str());
+
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Failed to initialize model instance ") + Name())
             .c_str());
+  }
 
-    stub_args[2] = bash_argument.c_str();
-    if (execvp("bash", (char**)stub_args) == -1) {
-      std::stringstream ss;
-      ss << "Failed to run python backend stub. Errno = " << errno << '\n'
-         << "Python backend stub path: " << python_backend_stub << '\n'
-         << "Shared Memory Region Name: " << shm_region_name << '\n'
-         << "Shared Memory Default Byte Size: " << shm_default_size << '\n'
-         << "Shared Memory Growth Byte Size: " << shm_growth_size << '\n';
-      std::string log_message = ss.str();
-      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, log_message.c_str());
+  int64_t stub_timeout_seconds =
+      model_state->StateForBackend()->stub_timeout_seconds;
 
-      return TRITONSERVER_ErrorNew(
-          TRITONSERVER_ERROR_INTERNAL,
-          (std::string("Failed to initialize model instance ") + Name())
-              .c_str());
-    }
+  stub_pid_ = pid;
+  boost::posix_time::ptime timeout =
+      boost::get_system_time() +
+      boost::posix_time::seconds(stub_timeout_seconds);
 
-  } else {
-    int64_t stub_timeout_seconds =
-        model_state->StateForBackend()->stub_timeout_seconds;
+  // Pre initialization step.
+  if (!parent_cond_->timed_wait(*parent_lock_, timeout)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Timed out occurred while waiting for the stub process. "
+                     "Failed to initialize model instance ") +
+         Name())
+            .c_str());
+  }
 
-    stub_pid_ = pid;
-    boost::posix_time::ptime timeout =
-        boost::get_system_time() +
-        boost::posix_time::seconds(stub_timeout_seconds);
+  off_t initialize_args_offset;
+  RETURN_IF_ERROR(SaveInitializeArgs(&initialize_args_offset));
+  ipc_message_->request_batch = initialize_args_offset;
 
-    // Pre initialization step.
-    if (!parent_cond_->timed_wait(*parent_lock_, timeout)) {
-      return TRITONSERVER_ErrorNew(
-          TRITONSERVER_ERROR_INTERNAL,
-          (std::string("Timed out occurred while waiting for the stub process. "
-                       "Failed to initialize model instance ") +
-           Name())
-              .c_str());
-    }
+  // If parent fails to notify the stub or the stub fails to notify the
+  // parent in a timely manner, kill the stub process and restart the
+  // stub process.
+  if (!NotifyStub() || !WaitForStubNotification()) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Failed to initialize stub, stub process exited "
+                     "unexpectedly: ") +
+         Name())
+            .c_str());
+  }
+
+  ResponseBatch* response_batch;
+  RETURN_IF_EXCEPTION(shm_pool_->MapOffset(
+      (char**)&response_batch, sizeof(RequestBatch),
+      ipc_message_->response_batch));
 
-    triton::common::TritonJson::WriteBuffer buffer;
-    Model()->ModelConfig().Write(&buffer);
+  if (response_batch->has_error) {
+    char* err_message;
+    RETURN_IF_EXCEPTION(LoadStringFromSharedMemory(
+        shm_pool_, response_batch->error, err_message));
+    return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_message);
+  }
 
-    std::unordered_map<std::string, std::string> initialize_args = {
-        {"model_config", buffer.MutableContents()},
-        {"model_instance_kind", TRITONSERVER_InstanceGroupKindString(kind_)},
-        {"model_instance_name", name_},
-        {"model_instance_device_id", std::to_string(device_id_)},
-        {"model_repository", model_state->RepositoryPath()},
-        {"model_version", std::to_string(model_state->Version())},
-        {"model_name", model_state->Name()}};
+  initialized_ = true;
+  RETURN_IF_ERROR(SetupStaticTensorSlots());
+  RETURN_IF_ERROR(Warmup());
 
-    off_t initialize_args_offset;
-    RETURN_IF_EXCEPTION(SaveMapToSharedMemory(
-        shm_pool_, initialize_args_offset, initialize_args));
-    ipc_message_->request_batch = initialize_args_offset;
-
-    // If parent fails to notify the stub or the stub fails to notify the
-    // parent in a timely manner, kill the stub process and restart the
-    // stub process.
-    if (!NotifyStub() || !WaitForStubNotification()) {
-      return TRITONSERVER_ErrorNew(
-          TRITONSERVER_ERROR_INTERNAL,
-          (std::string("Failed to initialize stub, stub process exited "
-                       "unexpectedly: ") +
-           name_)
-              .c_str());
-    }
+  return nullptr;  // success
+}
 
-    ResponseBatch* response_batch;
-    RETURN_IF_EXCEPTION(shm_pool_->MapOffset(
-        (char**)&response_batch, sizeof(RequestBatch),
-        ipc_message_->response_batch));
+TRITONSERVER_Error*
+StubProcess::SaveInitializeArgs(off_t* offset)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  triton::common::TritonJson::WriteBuffer buffer;
+  Model()->ModelConfig().Write(&buffer);
+
+  std::unordered_map<std::string, std::string> initialize_args = {
+      {"model_config", buffer.MutableContents()},
+      {"model_instance_kind",
+       TRITONSERVER_InstanceGroupKindString(model_instance_->Kind())},
+      {"model_instance_name", Name()},
+      {"model_instance_device_id", std::to_string(model_instance_->DeviceId())},
+      {"model_repository", model_state->RepositoryPath()},
+      {"model_version", std::to_string(model_state->Version())},
+      {"model_name", model_state->Name()}};
 
-    if (response_batch->has_error) {
-      char* err_message;
-      RETURN_IF_EXCEPTION(LoadStringFromSharedMemory(
-          shm_pool_, response_batch->error, err_message));
-      return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, err_message);
-    }
+  RETURN_IF_EXCEPTION(
+      SaveMapToSharedMemory(shm_pool_, *offset, initialize_args));
+  return nullptr;
+}
 
-    initialized_ = true;
+bool
+StubProcess::CanReload(BackendModelInstance* model_instance)
+{
+  std::lock_guard<std::mutex> lock(batch_mu_);
+  if (model_instance_ == nullptr) {
+    return false;
   }
 
-  return nullptr;  // success
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  ModelState* next_model_state =
+      reinterpret_cast<ModelState*>(model_instance->Model());
+  return (next_model_state->PythonExecutionEnv() ==
+          model_state->PythonExecutionEnv()) &&
+         (next_model_state->ExecuteThreadCount() ==
+          model_state->ExecuteThreadCount());
 }
 
 TRITONSERVER_Error*
-ModelInstanceState::SetupStubProcess()
+StubProcess::Reload(BackendModelInstance* model_instance)
 {
-  std::string kind = TRITONSERVER_InstanceGroupKindString(kind_);
-  std::string shm_region_name =
-      std::string("/") + Name() + "_" + kind + "_" + std::to_string(device_id_);
+  std::lock_guard<std::mutex> lock(batch_mu_);
+  BackendModelInstance* previous_instance = model_instance_;
+  const std::string previous_model_path = model_path_;
+  model_instance_ = model_instance;
 
-  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
-  int64_t shm_growth_size =
-      model_state->StateForBackend()->shm_growth_byte_size;
-  int64_t shm_default_size =
-      model_state->StateForBackend()->shm_default_byte_size;
+  model_path_ = ModelFilePath();
+  struct stat buffer;
+  TRITONSERVER_Error* err = nullptr;
+  if (stat(model_path_.c_str(), &buffer) != 0) {
+    err = TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        ("model.py does not exist in the model repository path: " + model_path_)
+            .c_str());
+  } else if (HasExited()) {
+    // Nothing runs the previous model anymore, so the stub process is
+    // restarted with the new one.
+    ResetSharedMemory();
+    err = StartStubProcess();
+    if (err == nullptr) {
+      return nullptr;
+    }
+  } else {
+    // The stub reloads the model when it receives a batch of size 0 with the
+    // initialize arguments of the new model.
+    const off_t reload_offset = shm_pool_->Offset();
+    off_t initialize_args_offset;
+    err = SaveInitializeArgs(&initialize_args_offset);
+    if (err == nullptr) {
+      try {
+        RequestBatch* request_batch;
+        off_t request_batch_offset;
+        shm_pool_->Map(
+            (char**)&request_batch, sizeof(RequestBatch), request_batch_offset);
+        request_batch->batch_size = 0;
+        request_batch->batch_input_count = 0;
+        request_batch->reload = initialize_args_offset;
 
-  try {
-    shm_pool_ = std::make_unique<SharedMemory>(
-        shm_region_name, shm_default_size, shm_growth_size,
-        true /* truncate */);
+        ResponseBatch* response_batch;
+        err = RunBatch(request_batch_offset, &response_batch);
+      }
+      catch (const PythonBackendException& pb_exception) {
+        err = CreateTritonErrorFromException(pb_exception);
+      }
+    }
+    shm_pool_->SetOffset(reload_offset);
   }
-  catch (const PythonBackendException& pb_exception) {
-    return TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+
+  if (err != nullptr) {
+    model_instance_ = previous_instance;
+    model_path_ = previous_model_path;
+    TRITONSERVER_Error* reload_err = TRITONSERVER_ErrorNew(
+        TRITONSERVER_ErrorCode(err),
+        (std::string("Failed to reload model instance ") + Name() +
+         " in its running stub process: " + TRITONSERVER_ErrorMessage(err))
+            .c_str());
+    TRITONSERVER_ErrorDelete(err);
+    return reload_err;
   }
 
-  // Stub mutex and CV
-  bi::interprocess_mutex* stub_mutex;
-  off_t stub_mutex_offset;
-  RETURN_IF_EXCEPTION(shm_pool_->Map(
-      (char**)&stub_mutex, sizeof(bi::interprocess_mutex), stub_mutex_offset));
-  stub_mutex = new (stub_mutex) bi::interprocess_mutex;
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_INFO,
+      (std::string("Reloaded model instance ") + Name() + " from " +
+       model_path_ + " in its running stub process")
+          .c_str());
 
-  bi::interprocess_condition* stub_cv;
-  off_t stub_cv_offset;
+  previous_instance_ = previous_instance;
+
+  // The static tensor slots of the previous model are replaced by the ones
+  // of the new model configuration.
+  ResetSharedMemory();
+  RETURN_IF_ERROR(SetupStaticTensorSlots());
+  return Warmup();
+}
+
+void
+StubProcess::Release(BackendModelInstance* model_instance)
+{
+  std::lock_guard<std::mutex> lock(batch_mu_);
+  if (previous_instance_ == model_instance) {
+    previous_instance_ = nullptr;
+    return;
+  }
+  if (model_instance_ != model_instance) {
+    return;
+  }
+
+  Terminate();
+  model_instance_ = previous_instance_;
+  previous_instance_ = nullptr;
+  if (model_instance_ == nullptr) {
+    return;
+  }
+
+  model_path_ = ModelFilePath();
+  ResetSharedMemory();
+  TRITONSERVER_Error* err = StartStubProcess();
+  if (err != nullptr) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_ERROR,
+        (std::string("Failed to restart the stub process of model instance ") +
+         Name() + " for its previous version: " +
+         TRITONSERVER_ErrorMessage(err))
+            .c_str());
+    TRITONSERVER_ErrorDelete(err);
+  }
+}
+
+std::string
+StubProcess::ModelFilePath()
+{
+  // Use <path>/version/model.py as the model location
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  return model_state->RepositoryPath() + "/" +
+         std::to_string(model_state->Version()) + "/model.py";
+}
+
+TRITONSERVER_Error*
+StubProcess::Warmup()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  for (const int64_t batch_size : model_state->WarmupBatchSizes()) {
+    uint64_t start_ns = 0;
+    SET_TIMESTAMP(start_ns);
+    for (int64_t i = 0; i < model_state->WarmupRepeatCount(); i++) {
+      TRITONSERVER_Error* err = ExecuteWarmupBatch(batch_size);
+      if (err != nullptr) {
+        TRITONSERVER_Error* warmup_err = TRITONSERVER_ErrorNew(
+            TRITONSERVER_ErrorCode(err),
+            (std::string("Failed to warm up model instance ") + Name() +
+             " with a batch of " + std::to_string(batch_size) +
+             " requests: " + TRITONSERVER_ErrorMessage(err))
+                .c_str());
+        TRITONSERVER_ErrorDelete(err);
+        return warmup_err;
+      }
+    }
+    uint64_t end_ns = 0;
+    SET_TIMESTAMP(end_ns);
+
+    const uint64_t duration_us = (end_ns - start_ns) / 1000;
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Warmed up model instance ") + Name() + " (stub process " +
+         std::to_string(index_) + ") with " +
+         std::to_string(model_state->WarmupRepeatCount()) + " batches of " +
+         std::to_string(batch_size) + " requests in " +
+         std::to_string(duration_us / 1000) + " ms, " +
+         std::to_string(duration_us / model_state->WarmupRepeatCount()) +
+         " us per batch")
+            .c_str());
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubProcess::ExecuteWarmupBatch(const size_t request_count)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  RequestBatch* request_batch;
+  off_t request_batch_offset;
+  RETURN_IF_EXCEPTION(shm_pool_->Map(
+      (char**)&request_batch, sizeof(RequestBatch), request_batch_offset));
+
+  // The inputs are filled with zeros, which are empty strings for the BYTES
+  // inputs, since their elements are prefixed with their 4-byte length.
+  TRITONSERVER_Error* err = nullptr;
+  try {
+    request_batch->batch_size = request_count;
+    request_batch->batch_input_count = 0;
+    request_batch->batch_inputs = 0;
+    Request* requests_shm;
+    shm_pool_->Map(
+        (char**)&requests_shm, sizeof(Request) * request_count,
+        request_batch->requests);
+
+    const auto& warmup_inputs = model_state->WarmupInputs();
+    const auto& warmup_outputs = model_state->WarmupOutputs();
+    for (size_t r = 0; r < request_count; r++) {
+      Request* request = &requests_shm[r];
+      SaveStringToSharedMemory(shm_pool_, request->id, "warmup");
+      request->correlation_id = 0;
+      request->requested_input_count = warmup_inputs.size();
+      request->requested_output_count = warmup_outputs.size();
+
+      Tensor* input_tensors;
+      shm_pool_->Map(
+          (char**)&input_tensors, sizeof(Tensor) * warmup_inputs.size(),
+          request->inputs);
+      for (size_t i = 0; i < warmup_inputs.size(); i++) {
+        const WarmupInput& input = warmup_inputs[i];
+        const int64_t element_count = GetElementCount(input.dims);
+        const uint64_t byte_size =
+            element_count * ((input.dtype == TRITONSERVER_TYPE_BYTES)
+                                 ? sizeof(uint32_t)
+                                 : TRITONSERVER_DataTypeByteSize(input.dtype));
+        char* data;
+        SaveRawDataToSharedMemory(
+            shm_pool_, input_tensors[i].raw_data, data,
+            TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, byte_size);
+        memset(data, 0, byte_size);
+        SaveTensorMetadata(
+            &input_tensors[i], input.name.c_str(), input.dims.data(),
+            input.dims.size(), input.dtype);
+      }
+
+      off_t* output_names;
+      shm_pool_->Map(
+          (char**)&output_names, sizeof(off_t) * warmup_outputs.size(),
+          request->requested_output_names);
+      for (size_t o = 0; o < warmup_outputs.size(); o++) {
+        auto slot = static_tensor_slots_.find(warmup_outputs[o]);
+        if (slot != static_tensor_slots_.end()) {
+          output_names[o] = slot->second.name;
+        } else {
+          SaveStringToSharedMemory(
+              shm_pool_, output_names[o], warmup_outputs[o].c_str());
+        }
+      }
+    }
+  }
+  catch (const PythonBackendException& pb_exception) {
+    err = CreateTritonErrorFromException(pb_exception);
+  }
+
+  // Check all the responses that the stub has published for errors.
+  ResponseBatch* response_batch = nullptr;
+  if (err == nullptr) {
+    err = RunBatch(request_batch_offset, &response_batch);
+  }
+  if (err == nullptr) {
+    try {
+      char* error_message = nullptr;
+      off_t completed_offset = response_batch->completed_responses;
+      while (completed_offset != 0) {
+        CompletedResponse* completed;
+        shm_pool_->MapOffset(
+            (char**)&completed, sizeof(CompletedResponse), completed_offset);
+        Response* response_shm;
+        if (completed->response != 0) {
+          shm_pool_->MapOffset(
+              (char**)&response_shm, sizeof(Response), completed->response);
+          if (response_shm->has_error) {
+            if (response_shm->is_error_set) {
+              LoadStringFromSharedMemory(
+                  shm_pool_, response_shm->error, error_message);
+            }
+            err = TRITONSERVER_ErrorNew(
+                TRITONSERVER_ERROR_INTERNAL,
+                (error_message != nullptr) ? error_message
+                                           : "A response has an error.");
+            break;
+          }
+        }
+        completed_offset = completed->next;
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      err = CreateTritonErrorFromException(pb_exception);
+    }
+  }
+
+  // The shared memory used by the batch is reused by the next one.
+  shm_pool_->SetOffset(request_batch_offset);
+  return err;
+}
+
+TRITONSERVER_Error*
+StubProcess::RunBatch(
+    const off_t request_batch_offset, ResponseBatch** response_batch)
+{
+  RETURN_IF_EXCEPTION(shm_pool_->MapOffset(
+      (char**)response_batch, sizeof(ResponseBatch),
+      ipc_message_->response_batch));
+  (*response_batch)->completed_responses = 0;
+  (*response_batch)->batch_done = false;
+  (*response_batch)->responses_released = false;
+  ipc_message_->request_batch = request_batch_offset;
+
+  bool stub_responding = NotifyStub();
+  while (stub_responding && !(*response_batch)->batch_done) {
+    stub_responding = WaitForStubNotification();
+  }
+  if (!stub_responding) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        "The stub process has exited unexpectedly.");
+  }
+
+  if ((*response_batch)->has_error) {
+    char* error_message = nullptr;
+    if ((*response_batch)->is_error_set) {
+      RETURN_IF_EXCEPTION(LoadStringFromSharedMemory(
+          shm_pool_, (*response_batch)->error, error_message));
+    }
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, (error_message != nullptr)
+                                         ? error_message
+                                         : "Failed to execute the batch.");
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubProcess::SetupStaticTensorSlots()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  const int max_batch_size = model_state->MaxBatchSize();
+
+  static_tensor_slots_.clear();
+  static_tensor_names_.clear();
+  for (const auto& static_tensor : model_state->StaticTensors()) {
+    StaticTensorSlot slot;
+    slot.config_dims = static_tensor.dims;
+    RETURN_IF_EXCEPTION(SaveStringToSharedMemory(
+        shm_pool_, slot.name, static_tensor.name.c_str()));
+
+    // Models that support batching have an extra batch dimension.
+    for (int batch_size = 0; batch_size <= max_batch_size; batch_size++) {
+      std::vector<int64_t> dims;
+      if (max_batch_size > 0) {
+        dims.push_back(batch_size);
+      }
+      dims.insert(
+          dims.end(), static_tensor.dims.begin(), static_tensor.dims.end());
+
+      int64_t* dims_shm;
+      off_t dims_offset;
+      RETURN_IF_EXCEPTION(shm_pool_->Map(
+          (char**)&dims_shm, sizeof(int64_t) * dims.size(), dims_offset));
+      std::copy(dims.begin(), dims.end(), dims_shm);
+      slot.dims.push_back(dims_offset);
+    }
+
+    static_tensor_names_.emplace(slot.name, static_tensor.name);
+    static_tensor_slots_.emplace(static_tensor.name, std::move(slot));
+  }
+
+  return nullptr;
+}
+
+bool
+StubProcess::UseStaticTensorSlot(
+    Tensor* tensor, const char* name, const int64_t* dims, size_t dims_count)
+{
+  auto it = static_tensor_slots_.find(name);
+  if (it == static_tensor_slots_.end()) {
+    return false;
+  }
+
+  const StaticTensorSlot& slot = it->second;
+  const size_t batch_dims = (slot.dims.size() > 1) ? 1 : 0;
+  if ((dims_count != slot.config_dims.size() + batch_dims) ||
+      !std::equal(
+          slot.config_dims.begin(), slot.config_dims.end(),
+          dims + batch_dims)) {
+    return false;
+  }
+
+  size_t batch_size = 0;
+  if (batch_dims == 1) {
+    if ((dims[0] < 0) || (static_cast<size_t>(dims[0]) >= slot.dims.size())) {
+      return false;
+    }
+    batch_size = dims[0];
+  }
+
+  tensor->name = slot.name;
+  tensor->dims = slot.dims[batch_size];
+  tensor->dims_count = dims_count;
+  return true;
+}
+
+void
+StubProcess::SaveTensorMetadata(
+    Tensor* tensor, const char* name, const int64_t* dims, size_t dims_count,
+    TRITONSERVER_DataType dtype)
+{
+  if (UseStaticTensorSlot(tensor, name, dims, dims_count)) {
+    tensor->dtype = dtype;
+  } else {
+    SaveTensorMetadataToSharedMemory(
+        shm_pool_, tensor, name, dims, dims_count, dtype);
+  }
+}
+
+TRITONSERVER_Error*
+StubProcess::SetupStubProcess()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  int64_t shm_growth_size =
+      model_state->StateForBackend()->shm_growth_byte_size;
+  int64_t shm_default_size =
+      model_state->StateForBackend()->shm_default_byte_size;
+
+  try {
+    shm_pool_ = std::make_unique<SharedMemory>(
+        shm_region_name_, shm_default_size, shm_growth_size,
+        true /* truncate */);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+  }
+
+  // Stub mutex and CV
+  bi::interprocess_mutex* stub_mutex;
+  off_t stub_mutex_offset;
+  RETURN_IF_EXCEPTION(shm_pool_->Map(
+      (char**)&stub_mutex, sizeof(bi::interprocess_mutex), stub_mutex_offset));
+  stub_mutex = new (stub_mutex) bi::interprocess_mutex;
+
+  bi::interprocess_condition* stub_cv;
+  off_t stub_cv_offset;
   RETURN_IF_EXCEPTION(shm_pool_->Map(
       (char**)&stub_cv, sizeof(bi::interprocess_condition), stub_cv_offset));
   stub_cv = new (stub_cv) bi::interprocess_condition;
@@ -1074,13 +2511,7 @@ ModelInstanceState::SetupStubProcess()
   RETURN_IF_EXCEPTION(
       shm_pool_->Map((char**)&ipc_message_, sizeof(IPCMessage), ipc_offset));
 
-  uint64_t model_version = model_state->Version();
-  const char* model_path = model_state->RepositoryPath().c_str();
-
-  std::stringstream ss;
-  // Use <path>/version/model.py as the model location
-  ss << model_path << "/" << model_version << "/model.py";
-  model_path_ = ss.str();
+  model_path_ = ModelFilePath();
   struct stat buffer;
 
   // Check if model.py exists
@@ -1104,182 +2535,1675 @@ ModelInstanceState::SetupStubProcess()
           TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
     }
 
-    path_to_activate_ = python_execution_env + "/bin/activate";
-    path_to_libpython_ = python_execution_env + "/lib";
-    if (python_execution_env.length() > 0 && !FileExists(path_to_activate_)) {
-      return TRITONSERVER_ErrorNew(
-          TRITONSERVER_ERROR_INTERNAL,
-          (std::string("Path ") + path_to_activate_ +
-           " does not exist. The Python environment should contain an "
-           "'activate' script.")
+    std::string path_to_activate = python_execution_env + "/bin/activate";
+    if (python_execution_env.length() > 0 && !FileExists(path_to_activate)) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("Path ") + path_to_activate +
+           " does not exist. The Python environment should contain an "
+           "'activate' script.")
+              .c_str());
+    }
+
+    // The environment is only activated once, and then passed to every stub
+    // process that uses it.
+    try {
+      stub_env_ =
+          model_state->StateForBackend()->env_manager->ActivatedEnvironment(
+              python_execution_env);
+    }
+    catch (PythonBackendException& pb_exception) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+    }
+  }
+
+  parent_pid_ = getpid();
+  shm_base_offset_ = shm_pool_->Offset();
+  RETURN_IF_ERROR(StartStubProcess());
+
+  return nullptr;
+}
+
+StubProcess::~StubProcess()
+{
+  Terminate();
+
+  // Destory the lock before deletion of shared memory is triggered.
+  parent_lock_.reset(nullptr);
+}
+
+void
+StubProcess::Terminate()
+{
+  bool exited = false;
+  if (initialized_) {
+    {
+      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
+      ipc_message_->health = false;
+    }
+
+    // Sleep 1 second so that the child process has a chance to change the
+    // health variable
+    sleep(1);
+
+    bool healthy = false;
+    {
+      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
+      healthy = ipc_message_->health;
+    }
+
+    if (healthy) {
+      // Signal to the termination to the Python backend stub using a request of
+      // size 0.
+      RequestBatch* request_batch;
+      off_t request_batch_offset;
+      shm_pool_->Map(
+          (char**)&request_batch, sizeof(RequestBatch), request_batch_offset);
+      request_batch->batch_size = 0;
+      request_batch->reload = 0;
+      ipc_message_->request_batch = request_batch_offset;
+
+      if (NotifyStub()) {
+        // Wait for stub notification
+        parent_cond_->wait(*parent_lock_);
+        exited = true;
+      }
+    }
+  }
+
+  // Terminate the stub process if it has been created. A shared stub process
+  // keeps running the stubs of the other models, so only a stub that has not
+  // exited by itself is stopped.
+  if (stub_pid_ != 0 && shared_) {
+    if (!exited) {
+      StopSharedStub();
+    }
+  } else if (stub_pid_ != 0) {
+    kill(stub_pid_, SIGTERM);
+    if (!WaitForStubExit()) {
+      kill(stub_pid_, SIGKILL);
+      WaitForStubExit();
+    }
+  }
+  initialized_ = false;
+  stub_pid_ = 0;
+}
+
+TRITONSERVER_Error*
+StubProcess::GetInputTensor(
+    const uint32_t input_idx, Tensor* input_tensor,
+    TRITONBACKEND_Request* request,
+    std::vector<TRITONBACKEND_Response*>& responses)
+{
+  const char* input_name;
+  // Load iidx'th input name
+  RETURN_IF_ERROR(
+      TRITONBACKEND_RequestInputName(request, input_idx, &input_name));
+
+  // Load iidx'th input
+  TRITONBACKEND_Input* in;
+  RETURN_IF_ERROR(TRITONBACKEND_RequestInput(request, input_name, &in));
+
+  // Load input properties
+  TRITONSERVER_DataType input_dtype;
+  const int64_t* input_shape;
+  uint32_t input_dims_count;
+  uint64_t input_byte_size;
+  uint32_t input_buffer_count;
+
+  RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+      in, &input_name, &input_dtype, &input_shape, &input_dims_count,
+      &input_byte_size, &input_buffer_count));
+
+  // If input_byte_size is larger than 2GBs, reject request the request.
+  uint64_t max_input_size = INT32_MAX;
+  if (input_byte_size > max_input_size) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        "Python backend does not support input size larger than 2GBs, consider "
+        "partitioning your input into multiple inputs.");
+  }
+
+  // Inputs converted to another data type are copied and converted in a
+  // single pass.
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  auto conversion = model_state->InputConversions().find(input_name);
+  if (conversion != model_state->InputConversions().end()) {
+    const TRITONSERVER_DataType python_dtype = conversion->second.python_dtype;
+    const uint64_t python_byte_size =
+        input_byte_size / TRITONSERVER_DataTypeByteSize(input_dtype) *
+        TRITONSERVER_DataTypeByteSize(python_dtype);
+
+    char* input_buffer;
+    RETURN_IF_EXCEPTION(SaveRawDataToSharedMemory(
+        shm_pool_, input_tensor->raw_data, input_buffer,
+        TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */,
+        python_byte_size));
+    RETURN_IF_EXCEPTION(SaveTensorMetadata(
+        input_tensor, input_name, input_shape, input_dims_count,
+        python_dtype));
+    return CopyInputConverted(in, input_dtype, python_dtype, input_buffer);
+  }
+
+  const TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+  const int memory_type_id = 0;
+
+  char* input_buffer;
+  RETURN_IF_EXCEPTION(SaveRawDataToSharedMemory(
+      shm_pool_, input_tensor->raw_data, input_buffer, memory_type,
+      memory_type_id, input_byte_size));
+  RETURN_IF_EXCEPTION(SaveTensorMetadata(
+      input_tensor, input_name, input_shape, input_dims_count, input_dtype));
+
+  bool copied;
+  RETURN_IF_ERROR(CopyInput(in, input_buffer, &copied));
+  if (copied) {
+    return nullptr;
+  }
+
+  // We need to create a new collector for every request because python backend
+  // sends each request individually to the python model
+  BackendInputCollector collector(
+      &request, 1, &responses, Model()->TritonMemoryManager(),
+      false /* pinned_enable */, CudaStream());
+
+  // Load raw data into input_tensor raw data.
+  // FIXME: Avoid the copy to CPU Memory when
+  // the data is in GPU.
+  collector.ProcessTensor(
+      input_name, input_buffer, input_byte_size, memory_type, memory_type_id);
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubProcess::PackInputTensor(
+    const std::string& input_name, const bool ragged,
+    TRITONBACKEND_Request** requests,
+    const uint32_t request_count,
+    std::vector<TRITONBACKEND_Response*>& responses, PackedInput* packed_input,
+    bool* packed)
+{
+  *packed = false;
+  packed_input->total_byte_size = 0;
+
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  auto conversion = model_state->InputConversions().find(input_name);
+  const bool convert = (conversion != model_state->InputConversions().end());
+
+  for (uint32_t r = 0; r < request_count; ++r) {
+    TRITONBACKEND_Input* in;
+    TRITONSERVER_Error* err =
+        TRITONBACKEND_RequestInput(requests[r], input_name.c_str(), &in);
+
+    // Optional inputs may be missing in some of the requests. These inputs
+    // are loaded for each request separately.
+    if (err != nullptr) {
+      TRITONSERVER_ErrorDelete(err);
+      return nullptr;
+    }
+
+    TRITONSERVER_DataType input_dtype;
+    const int64_t* input_shape;
+    uint32_t input_dims_count;
+    uint64_t input_byte_size;
+    RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+        in, nullptr, &input_dtype, &input_shape, &input_dims_count,
+        &input_byte_size, nullptr));
+
+    // If input_byte_size is larger than 2GBs, reject request the request.
+    uint64_t max_input_size = INT32_MAX;
+    if (input_byte_size > max_input_size) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_UNSUPPORTED,
+          "Python backend does not support input size larger than 2GBs, "
+          "consider partitioning your input into multiple inputs.");
+    }
+
+    if (r == 0) {
+      packed_input->dtype = input_dtype;
+    } else if (packed_input->dtype != input_dtype) {
+      return nullptr;
+    } else if (!ragged) {
+      const std::vector<int64_t>& first_shape = packed_input->shapes[0];
+      if ((input_dims_count == 0) ||
+          (first_shape.size() != input_dims_count) ||
+          !std::equal(
+              first_shape.begin() + 1, first_shape.end(), input_shape + 1)) {
+        return nullptr;
+      }
+    }
+
+    if (convert) {
+      input_byte_size =
+          input_byte_size / TRITONSERVER_DataTypeByteSize(input_dtype) *
+          TRITONSERVER_DataTypeByteSize(conversion->second.python_dtype);
+    }
+
+    packed_input->shapes.emplace_back(
+        input_shape, input_shape + input_dims_count);
+    packed_input->byte_offsets.push_back(packed_input->total_byte_size);
+    packed_input->byte_sizes.push_back(input_byte_size);
+    packed_input->total_byte_size += input_byte_size;
+  }
+
+  char* buffer;
+  RETURN_IF_EXCEPTION(shm_pool_->Map(
+      &buffer, packed_input->total_byte_size, packed_input->buffer_offset));
+
+  if (convert) {
+    for (uint32_t r = 0; r < request_count; ++r) {
+      TRITONBACKEND_Input* in;
+      RETURN_IF_ERROR(
+          TRITONBACKEND_RequestInput(requests[r], input_name.c_str(), &in));
+      RETURN_IF_ERROR(CopyInputConverted(
+          in, packed_input->dtype, conversion->second.python_dtype,
+          buffer + packed_input->byte_offsets[r]));
+    }
+    packed_input->dtype = conversion->second.python_dtype;
+
+    *packed = true;
+    return nullptr;
+  }
+
+  bool copied = true;
+  for (uint32_t r = 0; (r < request_count) && copied; ++r) {
+    TRITONBACKEND_Input* in;
+    RETURN_IF_ERROR(
+        TRITONBACKEND_RequestInput(requests[r], input_name.c_str(), &in));
+    RETURN_IF_ERROR(
+        CopyInput(in, buffer + packed_input->byte_offsets[r], &copied));
+  }
+  if (copied) {
+    *packed = true;
+    return nullptr;
+  }
+
+  // Inputs in the GPU memory are copied by a single collector, which copies
+  // the input of every request to its place in the packed buffer.
+  BackendInputCollector collector(
+      requests, request_count, &responses, Model()->TritonMemoryManager(),
+      false /* pinned_enable */, CudaStream());
+  collector.ProcessTensor(
+      input_name.c_str(), buffer, packed_input->total_byte_size,
+      TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */);
+  bool cuda_copy = collector.Finalize();
+#ifdef TRITON_ENABLE_GPU
+  if (cuda_copy) {
+    cudaStreamSynchronize(stream_);
+  }
+#else
+  (void)cuda_copy;
+#endif  // TRITON_ENABLE_GPU
+
+  *packed = true;
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubProcess::CopyInput(
+    TRITONBACKEND_Input* in, char* dst, bool* copied)
+{
+  uint32_t buffer_count;
+  RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+      in, nullptr, nullptr, nullptr, nullptr, nullptr, &buffer_count));
+
+  std::vector<std::pair<const void*, uint64_t>> buffers;
+  for (uint32_t b = 0; b < buffer_count; ++b) {
+    const void* buffer;
+    uint64_t buffer_byte_size;
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t memory_type_id = 0;
+    RETURN_IF_ERROR(TRITONBACKEND_InputBuffer(
+        in, b, &buffer, &buffer_byte_size, &memory_type, &memory_type_id));
+    if (memory_type == TRITONSERVER_MEMORY_GPU) {
+      *copied = false;
+      return nullptr;
+    }
+    buffers.emplace_back(buffer, buffer_byte_size);
+  }
+
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  CopyEngine* copy_engine = model_state->StateForBackend()->copy_engine.get();
+  for (const auto& buffer : buffers) {
+    copy_engine->Copy(
+        dst, static_cast<const char*>(buffer.first), buffer.second,
+        false /* non_temporal */);
+    dst += buffer.second;
+  }
+
+  *copied = true;
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubProcess::CopyInputConverted(
+    TRITONBACKEND_Input* in, TRITONSERVER_DataType src_dtype,
+    TRITONSERVER_DataType dst_dtype, char* dst)
+{
+  uint32_t buffer_count;
+  RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+      in, nullptr, nullptr, nullptr, nullptr, nullptr, &buffer_count));
+
+  const uint32_t src_element_size = TRITONSERVER_DataTypeByteSize(src_dtype);
+  const uint32_t dst_element_size = TRITONSERVER_DataTypeByteSize(dst_dtype);
+  std::vector<char> host_buffer;
+
+  // The buffers are not necessarily split at element boundaries, so the
+  // bytes of an element that spans two buffers are gathered in
+  // 'partial_element' first.
+  char partial_element[sizeof(int64_t)];
+  size_t partial_byte_size = 0;
+  for (uint32_t b = 0; b < buffer_count; ++b) {
+    const void* buffer;
+    uint64_t buffer_byte_size;
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t memory_type_id = 0;
+    RETURN_IF_ERROR(TRITONBACKEND_InputBuffer(
+        in, b, &buffer, &buffer_byte_size, &memory_type, &memory_type_id));
+
+    // GPU buffers are staged in the CPU memory before the conversion.
+    if (memory_type == TRITONSERVER_MEMORY_GPU) {
+      host_buffer.resize(buffer_byte_size);
+      bool cuda_used = false;
+      RETURN_IF_ERROR(CopyBuffer(
+          "Failed to copy input", memory_type, memory_type_id,
+          TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */,
+          buffer_byte_size, buffer, host_buffer.data(), CudaStream(),
+          &cuda_used));
+#ifdef TRITON_ENABLE_GPU
+      if (cuda_used) {
+        cudaStreamSynchronize(stream_);
+      }
+#endif  // TRITON_ENABLE_GPU
+      buffer = host_buffer.data();
+    }
+
+    const char* src = reinterpret_cast<const char*>(buffer);
+    if (partial_byte_size != 0) {
+      const size_t byte_size = std::min(
+          static_cast<uint64_t>(src_element_size - partial_byte_size),
+          buffer_byte_size);
+      std::memcpy(partial_element + partial_byte_size, src, byte_size);
+      partial_byte_size += byte_size;
+      src += byte_size;
+      buffer_byte_size -= byte_size;
+      if (partial_byte_size == src_element_size) {
+        ConvertBuffer(partial_element, src_dtype, dst, dst_dtype, 1);
+        dst += dst_element_size;
+        partial_byte_size = 0;
+      }
+    }
+
+    const size_t element_count = buffer_byte_size / src_element_size;
+    ConvertBuffer(src, src_dtype, dst, dst_dtype, element_count);
+    dst += element_count * dst_element_size;
+
+    const size_t remaining_byte_size =
+        buffer_byte_size - element_count * src_element_size;
+    if (remaining_byte_size != 0) {
+      std::memcpy(
+          partial_element + partial_byte_size,
+          src + element_count * src_element_size, remaining_byte_size);
+      partial_byte_size += remaining_byte_size;
+    }
+  }
+
+  if (partial_byte_size != 0) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        "The byte size of an input is not a multiple of the size of its "
+        "elements.");
+  }
+
+  return nullptr;
+}
+
+template <typename T>
+void
+WriteBatchInputValues(const std::vector<int64_t>& values, char* buffer)
+{
+  T* typed_buffer = reinterpret_cast<T*>(buffer);
+  for (size_t i = 0; i < values.size(); ++i) {
+    typed_buffer[i] = static_cast<T>(values[i]);
+  }
+}
+
+TRITONSERVER_Error*
+StubProcess::SaveBatchInputs(
+    RequestBatch* request_batch, TRITONBACKEND_Request** requests,
+    const uint32_t request_count,
+    const std::unordered_map<std::string, PackedInput>& packed_inputs)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  const std::vector<BatchInput>& batch_inputs = model_state->BatchInputs();
+
+  Tensor* batch_input_tensors;
+  off_t batch_input_tensors_offset;
+  uint32_t batch_input_count = packed_inputs.size() + batch_inputs.size();
+  RETURN_IF_EXCEPTION(shm_pool_->Map(
+      (char**)&batch_input_tensors, sizeof(Tensor) * batch_input_count,
+      batch_input_tensors_offset));
+  request_batch->batch_inputs = batch_input_tensors_offset;
+  request_batch->batch_input_count = batch_input_count;
+
+  // The packed inputs are concatenated along the first dimension when all the
+  // other dimensions match. Otherwise, they are exposed as a flat tensor.
+  size_t tensor_idx = 0;
+  for (const auto& packed_input : packed_inputs) {
+    const PackedInput& packed = packed_input.second;
+    std::vector<int64_t> batch_shape = packed.shapes[0];
+    bool concatenable = !batch_shape.empty();
+    for (size_t r = 1; r < packed.shapes.size() && concatenable; ++r) {
+      const std::vector<int64_t>& shape = packed.shapes[r];
+      concatenable = (shape.size() == batch_shape.size()) &&
+                     std::equal(shape.begin() + 1, shape.end(),
+                                batch_shape.begin() + 1);
+      if (concatenable) {
+        batch_shape[0] += shape[0];
+      }
+    }
+
+    if (!concatenable) {
+      int64_t element_count = 0;
+      for (const auto& shape : packed.shapes) {
+        element_count += GetElementCount(shape.data(), shape.size());
+      }
+      batch_shape = {element_count};
+    }
+
+    Tensor* batch_input_tensor = &batch_input_tensors[tensor_idx];
+    RETURN_IF_EXCEPTION(SaveRawDataViewToSharedMemory(
+        shm_pool_, batch_input_tensor->raw_data, packed.buffer_offset,
+        TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */,
+        packed.total_byte_size));
+    RETURN_IF_EXCEPTION(SaveTensorMetadata(
+        batch_input_tensor, packed_input.first.c_str(), batch_shape.data(),
+        batch_shape.size(), packed.dtype));
+    tensor_idx++;
+  }
+
+  for (const auto& batch_input : batch_inputs) {
+    std::vector<int64_t> element_counts;
+    for (uint32_t r = 0; r < request_count; ++r) {
+      TRITONBACKEND_Input* in;
+      RETURN_IF_ERROR(TRITONBACKEND_RequestInput(
+          requests[r], batch_input.source_input.c_str(), &in));
+
+      const int64_t* input_shape;
+      uint32_t input_dims_count;
+      RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+          in, nullptr, nullptr, &input_shape, &input_dims_count, nullptr,
+          nullptr));
+      element_counts.push_back(GetElementCount(input_shape, input_dims_count));
+    }
+
+    std::vector<int64_t> values;
+    std::vector<int64_t> shape;
+    switch (batch_input.kind) {
+      case BatchInput::Kind::BATCH_ELEMENT_COUNT:
+        values = element_counts;
+        break;
+      case BatchInput::Kind::BATCH_ACCUMULATED_ELEMENT_COUNT:
+        values.resize(element_counts.size());
+        std::partial_sum(
+            element_counts.begin(), element_counts.end(), values.begin());
+        break;
+      case BatchInput::Kind::BATCH_ACCUMULATED_ELEMENT_COUNT_WITH_ZERO:
+        values.resize(element_counts.size() + 1, 0);
+        std::partial_sum(
+            element_counts.begin(), element_counts.end(), values.begin() + 1);
+        break;
+      case BatchInput::Kind::BATCH_MAX_ELEMENT_COUNT_AS_SHAPE:
+        // Only the shape of this tensor is meaningful.
+        values.resize(
+            *std::max_element(element_counts.begin(), element_counts.end()),
+            0);
+        break;
+    }
+    shape.push_back(values.size());
+
+    char* buffer;
+    RETURN_IF_EXCEPTION(SaveTensorToSharedMemory(
+        shm_pool_, &batch_input_tensors[tensor_idx], buffer,
+        TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */,
+        values.size() * TRITONSERVER_DataTypeByteSize(batch_input.data_type),
+        batch_input.target_name.c_str(), shape.data(), shape.size(),
+        batch_input.data_type));
+
+    switch (batch_input.data_type) {
+      case TRITONSERVER_TYPE_INT32:
+        WriteBatchInputValues<int32_t>(values, buffer);
+        break;
+      case TRITONSERVER_TYPE_INT64:
+        WriteBatchInputValues<int64_t>(values, buffer);
+        break;
+      case TRITONSERVER_TYPE_FP32:
+        WriteBatchInputValues<float>(values, buffer);
+        break;
+      default:
+        break;
+    }
+    tensor_idx++;
+  }
+
+  return nullptr;
+}
+
+ModelInstanceState::ModelInstanceState(
+    ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance)
+    : BackendModelInstance(model_state, triton_model_instance),
+      exiting_(false)
+{
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::Create(
+    ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance,
+    ModelInstanceState** state)
+{
+  try {
+    *state = new ModelInstanceState(model_state, triton_model_instance);
+  }
+  catch (const BackendModelInstanceException& ex) {
+    RETURN_ERROR_IF_TRUE(
+        ex.err_ == nullptr, TRITONSERVER_ERROR_INTERNAL,
+        std::string("unexpected nullptr in BackendModelInstanceException"));
+    RETURN_IF_ERROR(ex.err_);
+  }
+  return nullptr;  // success
+}
+
+ModelInstanceState::~ModelInstanceState()
+{
+  if (setup_.valid()) {
+    setup_.wait();
+  }
+
+  // The dispatched requests are executed before the threads exit.
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    exiting_ = true;
+  }
+  cv_.notify_all();
+  for (auto& stub_thread : stub_threads_) {
+    stub_thread.join();
+  }
+
+  std::thread standby_thread;
+  {
+    std::lock_guard<std::mutex> lock(standby_mu_);
+    standby_thread = std::move(standby_thread_);
+  }
+  if (standby_thread.joinable()) {
+    standby_thread.join();
+  }
+
+  for (auto& stub : stubs_) {
+    stub->Release(this);
+  }
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::SetupStubProcesses()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  const size_t stub_count = model_state->StubProcessCount();
+  std::vector<bool> taken_over(stub_count, false);
+  for (size_t i = 0; i < stub_count; i++) {
+    taken_over[i] = TakeOverStubProcess(i);
+    if (!taken_over[i]) {
+      stubs_.emplace_back(new StubProcess(this, i));
+    }
+  }
+  if (model_state->StandbyStubProcess()) {
+    standby_.reset(new StubProcess(this, stub_count));
+  }
+
+  // A stub process taken over from the previous version only reloads the
+  // model.
+  auto setup_stub = [this, &taken_over](const size_t i) {
+    return taken_over[i] ? stubs_[i]->Reload(this)
+                         : stubs_[i]->SetupStubProcess();
+  };
+
+  if (model_state->ParallelInstanceInitialization()) {
+    // Each stub process spends most of its setup waiting for the Python model
+    // to be initialized, so they are created concurrently.
+    std::vector<TRITONSERVER_Error*> errors(stub_count + 1, nullptr);
+    std::vector<std::thread> setup_threads;
+    for (size_t i = 1; i < stub_count; i++) {
+      setup_threads.emplace_back(
+          [i, &errors, &setup_stub] { errors[i] = setup_stub(i); });
+    }
+    if (standby_ != nullptr) {
+      setup_threads.emplace_back([this, stub_count, &errors] {
+        errors[stub_count] = standby_->SetupStubProcess();
+      });
+    }
+    errors[0] = setup_stub(0);
+    for (auto& setup_thread : setup_threads) {
+      setup_thread.join();
+    }
+
+    TRITONSERVER_Error* error = nullptr;
+    for (TRITONSERVER_Error* stub_error : errors) {
+      if (error == nullptr) {
+        error = stub_error;
+      } else if (stub_error != nullptr) {
+        TRITONSERVER_ErrorDelete(stub_error);
+      }
+    }
+    RETURN_IF_ERROR(error);
+  } else {
+    for (size_t i = 0; i < stub_count; i++) {
+      RETURN_IF_ERROR(setup_stub(i));
+    }
+    if (standby_ != nullptr) {
+      RETURN_IF_ERROR(standby_->SetupStubProcess());
+    }
+  }
+
+  if (model_state->HotReload()) {
+    BackendState* backend_state = model_state->StateForBackend();
+    std::lock_guard<std::mutex> lock(backend_state->reloadable_stubs_mutex);
+    for (auto& stub : stubs_) {
+      backend_state->reloadable_stubs[stub->ShmRegionName()] = stub;
+    }
+  }
+
+  if (stub_count > 1) {
+    dispatched_requests_.resize(stub_count);
+    for (size_t i = 0; i < stub_count; i++) {
+      stub_threads_.emplace_back(&ModelInstanceState::StubThreadLoop, this, i);
+    }
+  }
+
+  return nullptr;
+}
+
+bool
+ModelInstanceState::TakeOverStubProcess(const size_t index)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  if (!model_state->HotReload()) {
+    return false;
+  }
+
+  // The stub process of the previous version has the same shared memory
+  // region name, which only depends on the model instance.
+  std::shared_ptr<StubProcess> previous_stub;
+  {
+    BackendState* backend_state = model_state->StateForBackend();
+    std::lock_guard<std::mutex> lock(backend_state->reloadable_stubs_mutex);
+    auto it = backend_state->reloadable_stubs.find(
+        StubShmRegionName(this, index));
+    if (it != backend_state->reloadable_stubs.end()) {
+      previous_stub = it->second.lock();
+    }
+  }
+  if ((previous_stub == nullptr) || !previous_stub->CanReload(this)) {
+    return false;
+  }
+
+  stubs_.push_back(std::move(previous_stub));
+  return true;
+}
+
+InstanceSetup
+ModelInstanceState::StartSetup()
+{
+  setup_ = std::async(std::launch::async, [this] {
+             return std::shared_ptr<TRITONSERVER_Error>(
+                 SetupStubProcesses(), TRITONSERVER_ErrorDelete);
+           }).share();
+  return setup_;
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::ProcessRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    bool* released)
+{
+  // Only needed if the model has more instances than expected from its
+  // configuration, since the model is not ready before all the setups are
+  // done otherwise.
+  if (setup_.valid()) {
+    TRITONSERVER_Error* setup_error = setup_.get().get();
+    if (setup_error != nullptr) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ErrorCode(setup_error),
+          TRITONSERVER_ErrorMessage(setup_error));
+    }
+  }
+
+  if (stubs_.size() == 1) {
+    *released = false;
+    return ExecuteRequests(0, requests, request_count);
+  }
+
+  // Wait for an idle stub process, and split the requests evenly across all
+  // the idle ones.
+  std::unique_lock<std::mutex> lock(mu_);
+  std::vector<size_t> idle_stubs;
+  cv_.wait(lock, [this, &idle_stubs] {
+    for (size_t i = 0; i < dispatched_requests_.size(); i++) {
+      if (dispatched_requests_[i].empty()) {
+        idle_stubs.push_back(i);
+      }
+    }
+    return !idle_stubs.empty();
+  });
+
+  const size_t sub_batch_count =
+      std::min<size_t>(idle_stubs.size(), request_count);
+  for (size_t s = 0; s < sub_batch_count; s++) {
+    const size_t begin = (size_t)request_count * s / sub_batch_count;
+    const size_t end = (size_t)request_count * (s + 1) / sub_batch_count;
+    dispatched_requests_[idle_stubs[s]].assign(
+        requests + begin, requests + end);
+  }
+  lock.unlock();
+  cv_.notify_all();
+
+  *released = true;
+  return nullptr;
+}
+
+void
+ModelInstanceState::StubThreadLoop(size_t index)
+{
+  std::vector<TRITONBACKEND_Request*> requests;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this, index] {
+        return exiting_ || !dispatched_requests_[index].empty();
+      });
+      if (dispatched_requests_[index].empty()) {
+        return;
+      }
+      requests = dispatched_requests_[index];
+    }
+
+    TRITONSERVER_Error* err =
+        ExecuteRequests(index, requests.data(), requests.size());
+    if (err != nullptr) {
+      // Same as when the execution of the model instance fails.
+      RequestsRespondWithError(requests.data(), requests.size(), err);
+    } else {
+      for (TRITONBACKEND_Request* request : requests) {
+        LOG_IF_ERROR(
+            TRITONBACKEND_RequestRelease(
+                request, TRITONSERVER_REQUEST_RELEASE_ALL),
+            "failed releasing request");
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      dispatched_requests_[index].clear();
+    }
+    cv_.notify_all();
+  }
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::ExecuteRequests(
+    const size_t index, TRITONBACKEND_Request** requests,
+    const uint32_t request_count)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  if (!model_state->StandbyStubProcess()) {
+    return stubs_[index]->ProcessRequests(requests, request_count);
+  }
+
+  std::vector<TRITONBACKEND_Request*> unfinished_requests;
+  RETURN_IF_ERROR(stubs_[index]->ProcessRequests(
+      requests, request_count, &unfinished_requests));
+  if (!stubs_[index]->HasExited()) {
+    return nullptr;
+  }
+
+  ReplaceStubProcess(index);
+  if (unfinished_requests.empty()) {
+    return nullptr;
+  }
+
+  if (model_state->ReplayOnStubFailure()) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Replaying ") +
+         std::to_string(unfinished_requests.size()) +
+         " requests of model instance " + Name() +
+         " interrupted by the failure of its stub process")
+            .c_str());
+    return stubs_[index]->ProcessRequests(
+        unfinished_requests.data(), unfinished_requests.size());
+  }
+
+  std::vector<TRITONBACKEND_Response*> responses;
+  for (TRITONBACKEND_Request* request : unfinished_requests) {
+    TRITONBACKEND_Response* response = nullptr;
+    LOG_IF_ERROR(
+        TRITONBACKEND_ResponseNew(&response, request),
+        "Fail to create response.");
+    responses.push_back(response);
+  }
+  stubs_[index]->RespondErrorToAllRequests(
+      "The stub process has exited unexpectedly.", responses,
+      unfinished_requests.data(), unfinished_requests.size());
+
+  return nullptr;
+}
+
+void
+ModelInstanceState::ReplaceStubProcess(const size_t index)
+{
+  std::thread previous_standby_thread;
+  {
+    std::lock_guard<std::mutex> lock(standby_mu_);
+    if (standby_ != nullptr) {
+      std::shared_ptr<StubProcess> failed_stub = std::move(stubs_[index]);
+      failed_stub->SetIndex(stubs_.size());
+      stubs_[index] = std::move(standby_);
+      stubs_[index]->SetIndex(index);
+      previous_standby_thread = std::move(standby_thread_);
+      standby_thread_ = std::thread(
+          &ModelInstanceState::RebuildStandby, this, failed_stub);
+    }
+  }
+
+  // The previous rebuild has already made its stub process the standby one,
+  // so its thread is done.
+  if (previous_standby_thread.joinable()) {
+    previous_standby_thread.join();
+  }
+  if (!stubs_[index]->HasExited()) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Switched model instance ") + Name() +
+         " to its standby stub process")
+            .c_str());
+    return;
+  }
+
+  stubs_[index]->ResetSharedMemory();
+  TRITONSERVER_Error* err = stubs_[index]->StartStubProcess();
+  if (err == nullptr) {
+    LOG_MESSAGE(TRITONSERVER_LOG_INFO, "Stub process successfully restarted.");
+  } else {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_ERROR,
+        (std::string(
+             "Stub process failed to restart. Your future requests to model ") +
+         Name() + " will fail until the standby stub process is ready. " +
+         "Error: " + TRITONSERVER_ErrorMessage(err))
+            .c_str());
+    TRITONSERVER_ErrorDelete(err);
+  }
+}
+
+void
+ModelInstanceState::RebuildStandby(std::shared_ptr<StubProcess> standby)
+{
+  std::chrono::seconds backoff(1);
+  const std::chrono::seconds max_backoff(60);
+  while (true) {
+    // The shared memory of the failed batch, or of the failed attempt, is
+    // freed first.
+    standby->ResetSharedMemory();
+    TRITONSERVER_Error* err = standby->StartStubProcess();
+    if (err == nullptr) {
+      break;
+    }
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_ERROR,
+        (std::string("Failed to rebuild the standby stub process of model "
+                     "instance ") +
+         Name() + ", retrying in " + std::to_string(backoff.count()) +
+         " seconds. The next failed stub process will be restarted in "
+         "place until then. Error: " +
+         TRITONSERVER_ErrorMessage(err))
+            .c_str());
+    TRITONSERVER_ErrorDelete(err);
+
+    std::unique_lock<std::mutex> lock(mu_);
+    if (cv_.wait_for(lock, backoff, [this] { return exiting_; })) {
+      return;
+    }
+    backoff = std::min(backoff * 2, max_backoff);
+  }
+
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_INFO,
+      (std::string("Standby stub process of model instance ") + Name() +
+       " is ready")
+          .c_str());
+  std::lock_guard<std::mutex> lock(standby_mu_);
+  standby_ = std::move(standby);
+}
+
+TRITONSERVER_Error*
+ModelState::Create(TRITONBACKEND_Model* triton_model, ModelState** state)
+{
+  try {
+    *state = new ModelState(triton_model);
+  }
+  catch (const BackendModelException& ex) {
+    RETURN_ERROR_IF_TRUE(
+        ex.err_ == nullptr, TRITONSERVER_ERROR_INTERNAL,
+        std::string("unexpected nullptr in BackendModelException"));
+    RETURN_IF_ERROR(ex.err_);
+  }
+
+  return nullptr;  // success
+}
+
+ModelState::ModelState(TRITONBACKEND_Model* triton_model)
+    : BackendModel(triton_model)
+{
+  TRITONBACKEND_Backend* backend;
+  THROW_IF_BACKEND_MODEL_ERROR(
+      TRITONBACKEND_ModelBackend(triton_model, &backend));
+
+  const char* path = nullptr;
+  TRITONBACKEND_ArtifactType artifact_type;
+  THROW_IF_BACKEND_MODEL_ERROR(
+      TRITONBACKEND_ModelRepository(triton_model, &artifact_type, &path));
+  python_execution_env_ = "";
+
+  void* bstate;
+  THROW_IF_BACKEND_MODEL_ERROR(TRITONBACKEND_BackendState(backend, &bstate));
+  backend_state_ = reinterpret_cast<BackendState*>(bstate);
+  triton::common::TritonJson::Value params;
+  if (model_config_.Find("parameters", &params)) {
+    // Skip the EXECUTION_ENV_PATH variable if it doesn't exist.
+    TRITONSERVER_Error* error =
+        GetParameterValue(params, "EXECUTION_ENV_PATH", &python_execution_env_);
+    if (error == nullptr) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_INFO,
+          (std::string("Using Python execution env ") + python_execution_env_)
+              .c_str());
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+  }
+
+  if (artifact_type != TRITONBACKEND_ARTIFACT_FILESYSTEM) {
+    throw triton::backend::BackendModelException(TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        (std::string("unsupported artifact type for model '") + Name() + "'")
+            .c_str()));
+  }
+
+  decoupled_ = false;
+  triton::common::TritonJson::Value transaction_policy;
+  if (model_config_.Find("model_transaction_policy", &transaction_policy)) {
+    triton::common::TritonJson::Value decoupled;
+    if (transaction_policy.Find("decoupled", &decoupled)) {
+      THROW_IF_BACKEND_MODEL_ERROR(decoupled.AsBool(&decoupled_));
+    }
+  }
+
+  THROW_IF_BACKEND_MODEL_ERROR(ParseRaggedBatchConfig());
+  THROW_IF_BACKEND_MODEL_ERROR(ParseStaticTensorConfig());
+  THROW_IF_BACKEND_MODEL_ERROR(ParseDtypeConversionConfig());
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseCountParameter("EXECUTE_THREAD_COUNT", &execute_thread_count_));
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseCountParameter("STUB_PROCESS_COUNT", &stub_process_count_));
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseMillisecondsParameter("EXECUTE_TIMEOUT_MS", &execute_timeout_ms_));
+  THROW_IF_BACKEND_MODEL_ERROR(ParseMillisecondsParameter(
+      "EXECUTE_TIMEOUT_PER_ITEM_MS", &execute_timeout_per_item_ms_));
+  execute_timeout_count_ = 0;
+  THROW_IF_BACKEND_MODEL_ERROR(ParseWarmupConfig());
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseBoolParameter("STANDBY_STUB_PROCESS", &standby_stub_process_));
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseBoolParameter("REPLAY_ON_STUB_FAILURE", &replay_on_stub_failure_));
+  THROW_IF_BACKEND_MODEL_ERROR(ParseBoolParameter(
+      "PARALLEL_INSTANCE_INITIALIZATION", &parallel_instance_initialization_));
+  added_instance_setup_count_ = 0;
+  THROW_IF_BACKEND_MODEL_ERROR(ConfiguredInstanceCount(&instance_count_));
+  ParseZygoteConfig();
+  THROW_IF_BACKEND_MODEL_ERROR(
+      ParseBoolParameter("SHARED_STUB_PROCESS", &uses_shared_stub_));
+
+  // The standby stub process and the zygote of a model are processes of its
+  // own, which a shared stub process replaces.
+  if (uses_shared_stub_ && (standby_stub_process_ || uses_zygote_)) {
+    THROW_IF_BACKEND_MODEL_ERROR(TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Model '") + Name() +
+         "' can't use 'SHARED_STUB_PROCESS' along with "
+         "'STANDBY_STUB_PROCESS' or the 'ZYGOTE_*' parameters")
+            .c_str()));
+  }
+
+  // Only the stub processes of the model instance itself are taken over by
+  // the next version. A zygote or a shared stub process belongs to the model
+  // state of its version, and the standby stub process is swapped with the
+  // failed ones.
+  THROW_IF_BACKEND_MODEL_ERROR(ParseBoolParameter("HOT_RELOAD", &hot_reload_));
+  if (hot_reload_ &&
+      (uses_shared_stub_ || standby_stub_process_ || uses_zygote_)) {
+    THROW_IF_BACKEND_MODEL_ERROR(TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Model '") + Name() +
+         "' can't use 'HOT_RELOAD' along with 'SHARED_STUB_PROCESS', "
+         "'STANDBY_STUB_PROCESS' or the 'ZYGOTE_*' parameters")
+            .c_str()));
+  }
+}
+
+TRITONSERVER_Error*
+ModelState::ParseIntList(
+    const std::string& key, const std::string& value,
+    std::vector<int64_t>* list)
+{
+  list->clear();
+  std::stringstream values(value);
+  std::string item;
+  while (std::getline(values, item, ',')) {
+    try {
+      size_t parsed_size;
+      list->push_back(std::stoll(item, &parsed_size));
+      if (item.find_first_not_of(" ", parsed_size) != std::string::npos) {
+        throw std::invalid_argument(item);
+      }
+    }
+    catch (const std::logic_error&) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (key + " of model '" + Name() +
+           "' must be a comma-separated list of integers, got '" + value +
+           "'.")
+              .c_str());
+    }
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelState::ParseWarmupConfig()
+{
+  warmup_batch_sizes_.clear();
+  RETURN_IF_ERROR(
+      ParseCountParameter("WARMUP_REPEAT_COUNT", &warmup_repeat_count_));
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return nullptr;
+  }
+
+  std::string batch_sizes;
+  TRITONSERVER_Error* error =
+      GetParameterValue(params, "WARMUP_BATCH_SIZES", &batch_sizes);
+  if (error != nullptr) {
+    TRITONSERVER_ErrorDelete(error);
+    return nullptr;
+  }
+  RETURN_IF_ERROR(
+      ParseIntList("WARMUP_BATCH_SIZES", batch_sizes, &warmup_batch_sizes_));
+
+  // The scheduler only sends one request at a time to the models that don't
+  // support batching.
+  const int64_t max_request_count = std::max(1, MaxBatchSize());
+  for (int64_t batch_size : warmup_batch_sizes_) {
+    if (batch_size <= 0 || batch_size > max_request_count) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("WARMUP_BATCH_SIZES of model '") + Name() +
+           "' must be between 1 and " + std::to_string(max_request_count) +
+           ", got '" + batch_sizes + "'.")
+              .c_str());
+    }
+  }
+
+  // Each request has a batch of one, and the variable dims of its inputs are
+  // set by the 'WARMUP_SHAPE_<input name>' parameters, or are 1.
+  triton::common::TritonJson::Value inputs;
+  if (model_config_.Find("input", &inputs)) {
+    for (size_t i = 0; i < inputs.ArraySize(); i++) {
+      triton::common::TritonJson::Value input;
+      RETURN_IF_ERROR(inputs.IndexAsObject(i, &input));
+      WarmupInput warmup_input;
+      RETURN_IF_ERROR(input.MemberAsString("name", &warmup_input.name));
+      std::string data_type;
+      RETURN_IF_ERROR(input.MemberAsString("data_type", &data_type));
+      warmup_input.dtype = ModelConfigDataTypeToTritonServerDataType(data_type);
+      auto conversion = input_conversions_.find(warmup_input.name);
+      if (conversion != input_conversions_.end()) {
+        warmup_input.dtype = conversion->second.python_dtype;
+      }
+
+      std::vector<int64_t> dims;
+      triton::common::TritonJson::Value reshape;
+      if (input.Find("reshape", &reshape)) {
+        RETURN_IF_ERROR(ParseShape(reshape, "shape", &dims));
+      } else {
+        RETURN_IF_ERROR(ParseShape(input, "dims", &dims));
+      }
+
+      std::string shape;
+      error = GetParameterValue(
+          params, "WARMUP_SHAPE_" + warmup_input.name, &shape);
+      if (error == nullptr) {
+        RETURN_IF_ERROR(
+            ParseIntList("WARMUP_SHAPE_" + warmup_input.name, shape, &dims));
+      } else {
+        TRITONSERVER_ErrorDelete(error);
+      }
+
+      if (MaxBatchSize() > 0) {
+        warmup_input.dims.push_back(1);
+      }
+      for (int64_t dim : dims) {
+        warmup_input.dims.push_back(std::max<int64_t>(dim, 1));
+      }
+      warmup_inputs_.push_back(std::move(warmup_input));
+    }
+  }
+
+  triton::common::TritonJson::Value outputs;
+  if (model_config_.Find("output", &outputs)) {
+    for (size_t i = 0; i < outputs.ArraySize(); i++) {
+      triton::common::TritonJson::Value output;
+      RETURN_IF_ERROR(outputs.IndexAsObject(i, &output));
+      std::string name;
+      RETURN_IF_ERROR(output.MemberAsString("name", &name));
+      warmup_outputs_.push_back(name);
+    }
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelState::ParseBoolParameter(const char* key, bool* value)
+{
+  *value = false;
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return nullptr;
+  }
+
+  std::string value_string;
+  TRITONSERVER_Error* error = GetParameterValue(params, key, &value_string);
+  if (error != nullptr) {
+    TRITONSERVER_ErrorDelete(error);
+    return nullptr;
+  }
+
+  if (value_string == "true") {
+    *value = true;
+  } else if (value_string != "false") {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string(key) + " of model '" + Name() +
+         "' must be 'true' or 'false', got '" + value_string + "'.")
+            .c_str());
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelState::ConfiguredInstanceCount(size_t* instance_count)
+{
+  // The server fills in the devices of the GPU instance groups, and creates
+  // 'count' instances for each of them.
+  *instance_count = 0;
+  triton::common::TritonJson::Value instance_groups;
+  if (!model_config_.Find("instance_group", &instance_groups)) {
+    return nullptr;
+  }
+
+  for (size_t i = 0; i < instance_groups.ArraySize(); i++) {
+    triton::common::TritonJson::Value instance_group;
+    RETURN_IF_ERROR(instance_groups.IndexAsObject(i, &instance_group));
+    int64_t count;
+    RETURN_IF_ERROR(instance_group.MemberAsInt("count", &count));
+    std::string kind;
+    RETURN_IF_ERROR(instance_group.MemberAsString("kind", &kind));
+
+    size_t device_count = 1;
+    triton::common::TritonJson::Value gpus;
+    if (kind == "KIND_GPU" && instance_group.Find("gpus", &gpus) &&
+        gpus.ArraySize() > 0) {
+      device_count = gpus.ArraySize();
+    }
+    *instance_count += count * device_count;
+  }
+
+  return nullptr;
+}
+
+std::vector<InstanceSetup>
+ModelState::AddInstanceSetup(const InstanceSetup& setup)
+{
+  std::lock_guard<std::mutex> lock(instance_setup_mutex_);
+  pending_instance_setups_.push_back(setup);
+  added_instance_setup_count_++;
+
+  // Instances that were not expected from the model configuration are
+  // waited for on their own.
+  if (added_instance_setup_count_ < instance_count_) {
+    return std::vector<InstanceSetup>();
+  }
+  return std::move(pending_instance_setups_);
+}
+
+void
+ModelState::ParseZygoteConfig()
+{
+  uses_zygote_ = false;
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return;
+  }
+
+  for (const auto& pair :
+       {std::make_pair("ZYGOTE_PRELOAD_MODULES", &zygote_preload_modules_),
+        std::make_pair(
+            "ZYGOTE_PREINITIALIZE_HOOK", &zygote_preinitialize_hook_)}) {
+    TRITONSERVER_Error* error =
+        GetParameterValue(params, pair.first, pair.second);
+    if (error == nullptr) {
+      uses_zygote_ = true;
+    } else {
+      TRITONSERVER_ErrorDelete(error);
+    }
+  }
+}
+
+TRITONSERVER_Error*
+ModelState::ForkStubProcess(
+    const std::vector<std::string>& stub_args, char** envp, pid_t* pid)
+{
+  std::lock_guard<std::mutex> lock(zygote_mutex_);
+  try {
+    if (zygote_ == nullptr || !zygote_->IsAlive()) {
+      if (zygote_ != nullptr) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_WARN,
+            (std::string("The stub zygote of model '") + Name() +
+             "' has exited, restarting it.")
+                .c_str());
+      }
+      zygote_.reset();
+
+      triton::common::TritonJson::WriteBuffer buffer;
+      RETURN_IF_ERROR(model_config_.Write(&buffer));
+      std::unordered_map<std::string, std::string> config = {
+          {"python_lib", backend_state_->python_lib},
+          {"model_repository", RepositoryPath()},
+          {"model_name", Name()},
+          {"model_version", std::to_string(Version())},
+          {"model_config", buffer.MutableContents()},
+          {"preload_modules", zygote_preload_modules_},
+          {"preinitialize_hook", zygote_preinitialize_hook_}};
+
+      uint64_t start_ns = 0;
+      SET_TIMESTAMP(start_ns);
+      zygote_ = std::make_unique<StubZygote>(stub_args[0], envp, config);
+      uint64_t end_ns = 0;
+      SET_TIMESTAMP(end_ns);
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_INFO,
+          (std::string("Started the stub zygote of model '") + Name() +
+           "' in " + std::to_string((end_ns - start_ns) / 1000000) + " ms")
+              .c_str());
+    }
+
+    *pid = zygote_->StartStub(stub_args);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Failed to fork a stub process of model '") + Name() +
+         "': " + pb_exception.what())
+            .c_str());
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelState::StartSharedStub(
+    const std::vector<std::string>& stub_args, char** envp, pid_t* pid,
+    std::string* key, uint64_t* generation)
+{
+  const std::string environment =
+      PythonExecutionEnv().empty() ? "default" : PythonExecutionEnv();
+  *key = stub_args[0] + ":" + environment;
+  std::lock_guard<std::mutex> lock(backend_state_->shared_stubs_mutex);
+  std::unique_ptr<StubZygote>& shared_stub =
+      backend_state_->shared_stubs[*key];
+  try {
+    if (shared_stub == nullptr || !shared_stub->IsAlive()) {
+      if (shared_stub != nullptr) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_WARN,
+            (std::string("The shared stub process of execution environment '") +
+             environment + "' has exited, restarting it.")
+                .c_str());
+      }
+      shared_stub.reset();
+      shared_stub = std::make_unique<StubZygote>(
+          stub_args[0], envp,
+          std::unordered_map<std::string, std::string>{
+              {"python_lib", backend_state_->python_lib}},
+          true /* shared */);
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_INFO,
+          (std::string("Started the shared stub process of execution "
+                       "environment '") +
+           environment + "'")
               .c_str());
     }
-  }
 
-  parent_pid_ = getpid();
-  RETURN_IF_ERROR(StartStubProcess());
+    *pid = shared_stub->StartStub(stub_args);
+    *generation = shared_stub->Generation();
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Failed to start a stub of model '") + Name() +
+         "' in the shared stub process: " + pb_exception.what())
+            .c_str());
+  }
 
   return nullptr;
 }
 
-ModelInstanceState::~ModelInstanceState()
+bool
+ModelState::SignalSharedStub(
+    const std::string& key, const uint64_t generation, const int signum)
 {
-  if (initialized_) {
-    {
-      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
-      ipc_message_->health = false;
+  std::lock_guard<std::mutex> lock(backend_state_->shared_stubs_mutex);
+  auto it = backend_state_->shared_stubs.find(key);
+  if ((it == backend_state_->shared_stubs.end()) || (it->second == nullptr) ||
+      (it->second->Generation() != generation)) {
+    return false;
+  }
+
+  if (signum == SIGKILL) {
+    if (!it->second->IsAlive()) {
+      return false;
     }
+    it->second->Kill();
+    return true;
+  }
+  return it->second->Signal(signum);
+}
 
-    // Sleep 1 second so that the child process has a chance to change the
-    // health variable
-    sleep(1);
+TRITONSERVER_Error*
+ModelState::ParseCountParameter(const char* key, int64_t* count)
+{
+  *count = 1;
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return nullptr;
+  }
 
-    bool healthy = false;
-    {
-      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
-      healthy = ipc_message_->health;
+  std::string count_string;
+  TRITONSERVER_Error* error = GetParameterValue(params, key, &count_string);
+  if (error != nullptr) {
+    TRITONSERVER_ErrorDelete(error);
+    return nullptr;
+  }
+
+  try {
+    size_t parsed_size;
+    *count = std::stoll(count_string, &parsed_size);
+    if (parsed_size != count_string.size()) {
+      throw std::invalid_argument(count_string);
     }
+  }
+  catch (const std::logic_error&) {
+    *count = 0;
+  }
+  if (*count <= 0) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string(key) + " of model '" + Name() +
+         "' must be a positive integer, got '" + count_string + "'.")
+            .c_str());
+  }
 
-    if (healthy) {
-      // Signal to the termination to the Python backend stub using a request of
-      // size 0.
-      RequestBatch* request_batch;
-      off_t request_batch_offset;
-      shm_pool_->Map(
-          (char**)&request_batch, sizeof(RequestBatch), request_batch_offset);
-      request_batch->batch_size = 0;
-      ipc_message_->request_batch = request_batch_offset;
+  return nullptr;
+}
 
-      if (NotifyStub()) {
-        // Wait for stub notification
-        parent_cond_->wait(*parent_lock_);
-      }
-    }
+TRITONSERVER_Error*
+ModelState::ParseMillisecondsParameter(const char* key, int64_t* milliseconds)
+{
+  *milliseconds = 0;
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return nullptr;
   }
 
-  // Terminate the stub process if it has been created.
-  if (stub_pid_ != 0) {
-    int status;
-    kill(stub_pid_, SIGTERM);
-    waitpid(stub_pid_, &status, 0);
+  std::string milliseconds_string;
+  TRITONSERVER_Error* error =
+      GetParameterValue(params, key, &milliseconds_string);
+  if (error != nullptr) {
+    TRITONSERVER_ErrorDelete(error);
+    return nullptr;
   }
 
-  // Destory the lock before deletion of shared memory is triggered.
-  parent_lock_.reset(nullptr);
+  try {
+    *milliseconds = std::stol(milliseconds_string);
+  }
+  catch (const std::logic_error&) {
+    *milliseconds = -1;
+  }
+  if (*milliseconds < 0) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string(key) + " of model '" + Name() +
+         "' must be a non-negative number of milliseconds, got '" +
+         milliseconds_string + "'.")
+            .c_str());
+  }
+
+  return nullptr;
 }
 
 TRITONSERVER_Error*
-ModelInstanceState::GetInputTensor(
-    const uint32_t input_idx, Tensor* input_tensor,
-    TRITONBACKEND_Request* request,
-    std::vector<TRITONBACKEND_Response*>& responses)
+ModelState::ParseDtypeConversionConfig()
 {
-  const char* input_name;
-  // Load iidx'th input name
-  RETURN_IF_ERROR(
-      TRITONBACKEND_RequestInputName(request, input_idx, &input_name));
+  triton::common::TritonJson::Value params;
+  if (!model_config_.Find("parameters", &params)) {
+    return nullptr;
+  }
 
-  // Load iidx'th input
-  TRITONBACKEND_Input* in;
-  RETURN_IF_ERROR(TRITONBACKEND_RequestInput(request, input_name, &in));
+  for (const char* io_kind : {"input", "output"}) {
+    const bool is_input = (std::string(io_kind) == "input");
+    triton::common::TritonJson::Value ios;
+    if (!model_config_.Find(io_kind, &ios)) {
+      continue;
+    }
 
-  // Load input properties
-  TRITONSERVER_DataType input_dtype;
-  const int64_t* input_shape;
-  uint32_t input_dims_count;
-  uint64_t input_byte_size;
-  uint32_t input_buffer_count;
+    for (size_t i = 0; i < ios.ArraySize(); i++) {
+      triton::common::TritonJson::Value io;
+      RETURN_IF_ERROR(ios.IndexAsObject(i, &io));
 
-  RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
-      in, &input_name, &input_dtype, &input_shape, &input_dims_count,
-      &input_byte_size, &input_buffer_count));
+      std::string name;
+      RETURN_IF_ERROR(io.MemberAsString("name", &name));
 
-  // If input_byte_size is larger than 2GBs, reject request the request.
-  uint64_t max_input_size = INT32_MAX;
-  if (input_byte_size > max_input_size) {
-    return TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_UNSUPPORTED,
-        "Python backend does not support input size larger than 2GBs, consider "
-        "partitioning your input into multiple inputs.");
-  }
+      std::string python_data_type;
+      TRITONSERVER_Error* error = GetParameterValue(
+          params, "PYTHON_DTYPE_" + name, &python_data_type);
+      if (error != nullptr) {
+        TRITONSERVER_ErrorDelete(error);
+        continue;
+      }
 
-  // We need to create a new collector for every request because python backend
-  // sends each request individually to the python model
-  BackendInputCollector collector(
-      &request, 1, &responses, Model()->TritonMemoryManager(),
-      false /* pinned_enable */, CudaStream());
+      std::string config_data_type;
+      RETURN_IF_ERROR(io.MemberAsString("data_type", &config_data_type));
 
-  const TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
-  const int memory_type_id = 0;
+      DtypeConversion conversion;
+      conversion.config_dtype =
+          ModelConfigDataTypeToTritonServerDataType(config_data_type);
+      conversion.python_dtype =
+          ModelConfigDataTypeToTritonServerDataType(python_data_type);
+      if (conversion.config_dtype == conversion.python_dtype) {
+        continue;
+      }
 
-  char* input_buffer;
-  RETURN_IF_EXCEPTION(SaveTensorToSharedMemory(
-      shm_pool_, input_tensor, input_buffer, memory_type, memory_type_id,
-      input_byte_size, input_name, input_shape, input_dims_count, input_dtype));
+      // Inputs are converted from the configured data type, outputs to it.
+      const bool supported =
+          is_input ? IsDtypeConversionSupported(
+                         conversion.config_dtype, conversion.python_dtype)
+                   : IsDtypeConversionSupported(
+                         conversion.python_dtype, conversion.config_dtype);
+      if (!supported) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("unsupported PYTHON_DTYPE_") + name + " '" +
+             python_data_type + "' for " + io_kind + " of type " +
+             config_data_type +
+             ". Supported conversions are TYPE_FP64 <-> TYPE_FP32, TYPE_FP32 "
+             "<-> TYPE_FP16 and integer widening.")
+                .c_str());
+      }
 
-  // Load raw data into input_tensor raw data.
-  // FIXME: Avoid the copy to CPU Memory when
-  // the data is in GPU.
-  collector.ProcessTensor(
-      input_name, input_buffer, input_byte_size, memory_type, memory_type_id);
+      if (is_input) {
+        input_conversions_.emplace(name, conversion);
+      } else {
+        output_conversions_.emplace(name, conversion);
+      }
+    }
+  }
 
   return nullptr;
 }
 
 TRITONSERVER_Error*
-ModelState::Create(TRITONBACKEND_Model* triton_model, ModelState** state)
+ModelState::ParseStaticTensorConfig()
 {
-  try {
-    *state = new ModelState(triton_model);
-  }
-  catch (const BackendModelException& ex) {
-    RETURN_ERROR_IF_TRUE(
-        ex.err_ == nullptr, TRITONSERVER_ERROR_INTERNAL,
-        std::string("unexpected nullptr in BackendModelException"));
-    RETURN_IF_ERROR(ex.err_);
+  for (const char* io_kind : {"input", "output"}) {
+    triton::common::TritonJson::Value ios;
+    if (!model_config_.Find(io_kind, &ios)) {
+      continue;
+    }
+
+    for (size_t i = 0; i < ios.ArraySize(); i++) {
+      triton::common::TritonJson::Value io;
+      RETURN_IF_ERROR(ios.IndexAsObject(i, &io));
+
+      // The shape seen by the backend differs from 'dims' for reshaped
+      // tensors.
+      if (io.Find("reshape")) {
+        continue;
+      }
+
+      StaticTensor static_tensor;
+      RETURN_IF_ERROR(io.MemberAsString("name", &static_tensor.name));
+      RETURN_IF_ERROR(ParseShape(io, "dims", &static_tensor.dims));
+      if (std::all_of(
+              static_tensor.dims.begin(), static_tensor.dims.end(),
+              [](int64_t dim) { return dim >= 0; })) {
+        static_tensors_.push_back(std::move(static_tensor));
+      }
+    }
   }
 
-  return nullptr;  // success
+  return nullptr;
 }
 
-ModelState::ModelState(TRITONBACKEND_Model* triton_model)
-    : BackendModel(triton_model)
+TRITONSERVER_Error*
+ModelState::ParseRaggedBatchConfig()
 {
-  TRITONBACKEND_Backend* backend;
-  THROW_IF_BACKEND_MODEL_ERROR(
-      TRITONBACKEND_ModelBackend(triton_model, &backend));
+  triton::common::TritonJson::Value inputs;
+  if (model_config_.Find("input", &inputs)) {
+    for (size_t i = 0; i < inputs.ArraySize(); i++) {
+      triton::common::TritonJson::Value input;
+      RETURN_IF_ERROR(inputs.IndexAsObject(i, &input));
+
+      bool allow_ragged_batch = false;
+      if (input.Find("allow_ragged_batch")) {
+        RETURN_IF_ERROR(
+            input.MemberAsBool("allow_ragged_batch", &allow_ragged_batch));
+      }
 
-  const char* path = nullptr;
-  TRITONBACKEND_ArtifactType artifact_type;
-  THROW_IF_BACKEND_MODEL_ERROR(
-      TRITONBACKEND_ModelRepository(triton_model, &artifact_type, &path));
-  python_execution_env_ = "";
+      if (allow_ragged_batch) {
+        std::string input_name;
+        RETURN_IF_ERROR(input.MemberAsString("name", &input_name));
+        ragged_inputs_.insert(input_name);
+      }
+    }
+  }
 
-  void* bstate;
-  THROW_IF_BACKEND_MODEL_ERROR(TRITONBACKEND_BackendState(backend, &bstate));
-  backend_state_ = reinterpret_cast<BackendState*>(bstate);
-  triton::common::TritonJson::Value params;
-  if (model_config_.Find("parameters", &params)) {
-    // Skip the EXECUTION_ENV_PATH variable if it doesn't exist.
-    TRITONSERVER_Error* error =
-        GetParameterValue(params, "EXECUTION_ENV_PATH", &python_execution_env_);
-    if (error == nullptr) {
-      LOG_MESSAGE(
-          TRITONSERVER_LOG_INFO,
-          (std::string("Using Python execution env ") + python_execution_env_)
-              .c_str());
+  triton::common::TritonJson::Value batch_inputs;
+  if (!model_config_.Find("batch_input", &batch_inputs)) {
+    return nullptr;
+  }
+
+  for (size_t i = 0; i < batch_inputs.ArraySize(); i++) {
+    triton::common::TritonJson::Value batch_input_config;
+    RETURN_IF_ERROR(batch_inputs.IndexAsObject(i, &batch_input_config));
+
+    BatchInput batch_input;
+    std::string kind;
+    RETURN_IF_ERROR(batch_input_config.MemberAsString("kind", &kind));
+    if (kind == "BATCH_ELEMENT_COUNT") {
+      batch_input.kind = BatchInput::Kind::BATCH_ELEMENT_COUNT;
+    } else if (kind == "BATCH_ACCUMULATED_ELEMENT_COUNT") {
+      batch_input.kind = BatchInput::Kind::BATCH_ACCUMULATED_ELEMENT_COUNT;
+    } else if (kind == "BATCH_ACCUMULATED_ELEMENT_COUNT_WITH_ZERO") {
+      batch_input.kind =
+          BatchInput::Kind::BATCH_ACCUMULATED_ELEMENT_COUNT_WITH_ZERO;
+    } else if (kind == "BATCH_MAX_ELEMENT_COUNT_AS_SHAPE") {
+      batch_input.kind = BatchInput::Kind::BATCH_MAX_ELEMENT_COUNT_AS_SHAPE;
     } else {
-      // Delete the error
-      TRITONSERVER_ErrorDelete(error);
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_UNSUPPORTED,
+          (std::string("batch input kind '") + kind +
+           "' is not supported by Python backend")
+              .c_str());
     }
-  }
 
-  if (artifact_type != TRITONBACKEND_ARTIFACT_FILESYSTEM) {
-    throw triton::backend::BackendModelException(TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_UNSUPPORTED,
-        (std::string("unsupported artifact type for model '") + Name() + "'")
-            .c_str()));
+    std::string data_type;
+    RETURN_IF_ERROR(batch_input_config.MemberAsString("data_type", &data_type));
+    batch_input.data_type = ModelConfigDataTypeToTritonServerDataType(data_type);
+    if ((batch_input.data_type != TRITONSERVER_TYPE_INT32) &&
+        (batch_input.data_type != TRITONSERVER_TYPE_INT64) &&
+        (batch_input.data_type != TRITONSERVER_TYPE_FP32)) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("batch input data type must be TYPE_INT32, TYPE_INT64 "
+                       "or TYPE_FP32, got ") +
+           data_type)
+              .c_str());
+    }
+
+    triton::common::TritonJson::Value target_names;
+    RETURN_IF_ERROR(
+        batch_input_config.MemberAsArray("target_name", &target_names));
+    triton::common::TritonJson::Value source_inputs;
+    RETURN_IF_ERROR(
+        batch_input_config.MemberAsArray("source_input", &source_inputs));
+    if ((target_names.ArraySize() != 1) || (source_inputs.ArraySize() != 1)) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("batch input of kind '") + kind +
+           "' expects exactly one target name and one source input")
+              .c_str());
+    }
+    RETURN_IF_ERROR(target_names.IndexAsString(0, &batch_input.target_name));
+    RETURN_IF_ERROR(source_inputs.IndexAsString(0, &batch_input.source_input));
+
+    batch_inputs_.push_back(batch_input);
   }
+
+  return nullptr;
 }
 
 extern "C" {
@@ -1331,6 +4255,9 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
   backend_state->shm_default_byte_size = 64 * 1024 * 1024;  // 64 MBs
   backend_state->shm_growth_byte_size = 64 * 1024 * 1024;   // 64 MBs
   backend_state->stub_timeout_seconds = 30;
+  backend_state->copy_thread_count =
+      std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+  backend_state->copy_parallel_byte_size = 8 * 1024 * 1024;  // 8 MBs
 
   if (backend_config.Find("cmdline", &cmdline)) {
     triton::common::TritonJson::Value shm_growth_size;
@@ -1392,6 +4319,50 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
         return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
       }
     }
+
+    triton::common::TritonJson::Value copy_thread_count;
+    std::string copy_thread_count_string;
+    if (cmdline.Find("copy-thread-count", &copy_thread_count)) {
+      RETURN_IF_ERROR(copy_thread_count.AsString(&copy_thread_count_string));
+      try {
+        backend_state->copy_thread_count = std::stol(copy_thread_count_string);
+        if (backend_state->copy_thread_count <= 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("copy-thread-count") +
+               " can't be smaller than or equal to zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value copy_parallel_size;
+    std::string copy_parallel_byte_size;
+    if (cmdline.Find("copy-parallel-byte-size", &copy_parallel_size)) {
+      RETURN_IF_ERROR(copy_parallel_size.AsString(&copy_parallel_byte_size));
+      try {
+        backend_state->copy_parallel_byte_size =
+            std::stol(copy_parallel_byte_size);
+        if (backend_state->copy_parallel_byte_size <= 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("copy-parallel-byte-size") +
+               " can't be smaller than or equal to zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value env_cache_path;
+    if (cmdline.Find("env-cache-path", &env_cache_path)) {
+      RETURN_IF_ERROR(env_cache_path.AsString(&backend_state->env_cache_path));
+    }
   }
 
   LOG_MESSAGE(
@@ -1401,7 +4372,12 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
        ",shm-growth-byte-size=" +
        std::to_string(backend_state->shm_growth_byte_size) +
        ",stub-timeout-seconds=" +
-       std::to_string(backend_state->stub_timeout_seconds))
+       std::to_string(backend_state->stub_timeout_seconds) +
+       ",copy-thread-count=" +
+       std::to_string(backend_state->copy_thread_count) +
+       ",copy-parallel-byte-size=" +
+       std::to_string(backend_state->copy_parallel_byte_size) +
+       ",env-cache-path=" + backend_state->env_cache_path)
           .c_str());
 
   // Use BackendArtifacts to determine the location of Python files
@@ -1410,7 +4386,17 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
   RETURN_IF_ERROR(
       TRITONBACKEND_BackendArtifacts(backend, &artifact_type, &location));
   backend_state->python_lib = location;
-  backend_state->env_manager = std::make_unique<EnvironmentManager>();
+  try {
+    backend_state->env_manager =
+        std::make_unique<EnvironmentManager>(backend_state->env_cache_path);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+  }
+  backend_state->copy_engine = std::make_unique<CopyEngine>(
+      backend_state->copy_thread_count,
+      backend_state->copy_parallel_byte_size);
 
   RETURN_IF_ERROR(TRITONBACKEND_BackendSetState(
       backend, reinterpret_cast<void*>(backend_state.get())));
@@ -1426,6 +4412,14 @@ TRITONBACKEND_Finalize(TRITONBACKEND_Backend* backend)
   void* vstate;
   RETURN_IF_ERROR(TRITONBACKEND_BackendState(backend, &vstate));
   auto backend_state = reinterpret_cast<BackendState*>(vstate);
+  CopyStats copy_stats = backend_state->copy_engine->Stats();
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("Copied ") + std::to_string(copy_stats.byte_size) +
+       " bytes in " + std::to_string(copy_stats.copy_count) + " copies (" +
+       std::to_string(copy_stats.duration_ns / 1000000) +
+       " ms) to and from shared memory")
+          .c_str());
   delete backend_state;
   LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE, "TRITONBACKEND_Finalize: End");
   return nullptr;  // success
@@ -1506,7 +4500,31 @@ TRITONBACKEND_ModelInstanceInitialize(TRITONBACKEND_ModelInstance* instance)
   RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceSetState(
       instance, reinterpret_cast<void*>(instance_state)));
 
-  RETURN_IF_ERROR(instance_state->SetupStubProcess());
+  if (model_state->ParallelInstanceInitialization()) {
+    // The model is ready once all its instances are initialized, so the last
+    // instance waits for the others, and fails if any of them has failed.
+    std::vector<InstanceSetup> setups =
+        model_state->AddInstanceSetup(instance_state->StartSetup());
+    if (setups.empty()) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_VERBOSE,
+          (std::string("TRITONBACKEND_ModelInstanceInitialize: instance "
+                       "initialization started ") +
+           name + " (device " + std::to_string(device_id) + ")")
+              .c_str());
+      return nullptr;
+    }
+    for (const InstanceSetup& setup : setups) {
+      TRITONSERVER_Error* setup_error = setup.get().get();
+      if (setup_error != nullptr) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ErrorCode(setup_error),
+            TRITONSERVER_ErrorMessage(setup_error));
+      }
+    }
+  } else {
+    RETURN_IF_ERROR(instance_state->SetupStubProcesses());
+  }
   LOG_MESSAGE(
       TRITONSERVER_LOG_VERBOSE,
       (std::string("TRITONBACKEND_ModelInstanceInitialize: instance "
@@ -1525,7 +4543,12 @@ TRITONBACKEND_ModelInstanceExecute(
   ModelInstanceState* instance_state;
   RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceState(
       instance, reinterpret_cast<void**>(&instance_state)));
-  RETURN_IF_ERROR(instance_state->ProcessRequests(requests, request_count));
+  bool released;
+  RETURN_IF_ERROR(
+      instance_state->ProcessRequests(requests, request_count, &released));
+  if (released) {
+    return nullptr;
+  }
 
   for (uint32_t r = 0; r < request_count; ++r) {
     TRITONBACKEND_Request* request = requests[r];
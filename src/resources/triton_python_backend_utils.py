@@ -24,9 +24,14 @@
 # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+import asyncio
 import numpy as np
 import struct
 
+# Flag of the last response of a request, see
+# InferenceResponseSender.send.
+TRITONSERVER_RESPONSE_COMPLETE_FINAL = 1
+
 TRITON_STRING_TO_NUMPY = {
     'TYPE_BOOL': bool,
     'TYPE_UINT8': np.uint8,
@@ -137,14 +142,30 @@ class InferenceRequest:
     requested_output_name : list
         The names of the output tensors that should be calculated and
         returned for this request.
+    batch_inputs : dict or callable
+        The tensors shared by all the requests in the batch, indexed by
+        name. These are the packed inputs and the batch inputs generated by
+        the backend. It can also be a function that returns them, which is
+        only called once they are needed.
+    response_sender : InferenceResponseSender
+        The object used to send the responses of this request, or None if the
+        model is not decoupled.
     """
 
-    def __init__(self, inputs, request_id, correlation_id,
-                 requested_output_names):
+    def __init__(self,
+                 inputs,
+                 request_id,
+                 correlation_id,
+                 requested_output_names,
+                 batch_inputs=None,
+                 response_sender=None):
         self._inputs = inputs
         self._request_id = request_id
         self._correlation_id = correlation_id
         self._requested_output_names = requested_output_names
+        self._requested_output_name_set = set(requested_output_names)
+        self._batch_inputs = batch_inputs if batch_inputs is not None else {}
+        self._response_sender = response_sender
 
     def inputs(self):
         """Get input tensors
@@ -182,6 +203,94 @@ class InferenceRequest:
         """
         return self._requested_output_names
 
+    def is_output_requested(self, name):
+        """Check whether the output with the given name was requested.
+        Outputs that were not requested are dropped by the backend, so
+        models can skip computing them.
+        Parameters
+        ----------
+        name : str
+            name of the output
+        Returns
+        -------
+        bool
+            True if the output should be returned for this request
+        """
+        return name in self._requested_output_name_set
+
+    def batch_inputs(self):
+        """Get the tensors shared by all the requests in the batch
+        Returns
+        -------
+        dict
+            A dictionary of Tensor objects indexed by name
+        """
+        if callable(self._batch_inputs):
+            self._batch_inputs = self._batch_inputs()
+        return self._batch_inputs
+
+    def get_response_sender(self):
+        """Get the object used to send the responses of this request. Only
+        models using the decoupled transaction policy have one.
+        Returns
+        -------
+        InferenceResponseSender
+            The response sender of this request
+        """
+        if self._response_sender is None:
+            raise TritonModelException(
+                'Response senders are only available to models using the '
+                'decoupled transaction policy.')
+        return self._response_sender
+
+
+class InferenceResponseSender:
+    """An InferenceResponseSender object sends the responses of a request
+    of a decoupled model. Any number of responses can be sent, the last one
+    with the TRITONSERVER_RESPONSE_COMPLETE_FINAL flag. Each response is
+    forwarded by the backend as soon as it is sent. The sender can only be
+    used until `execute` returns, the requests that are not complete by then
+    are completed by the backend.
+    Parameters
+    ----------
+    send : callable
+        The function that sends a response and its flags to the backend
+    """
+
+    def __init__(self, send):
+        self._send = send
+        self._complete = False
+
+    def send(self, response=None, flags=0):
+        """Send a response of the request.
+        Parameters
+        ----------
+        response : InferenceResponse
+            The response to send, or None to only send the flags
+        flags : int
+            TRITONSERVER_RESPONSE_COMPLETE_FINAL if this is the last response
+            of the request, 0 otherwise
+        """
+        if self._complete:
+            raise TritonModelException(
+                'The final response of this request has already been sent.')
+        final = (flags & TRITONSERVER_RESPONSE_COMPLETE_FINAL) != 0
+        if response is None and not final:
+            raise TritonModelException(
+                'A response without the '
+                'TRITONSERVER_RESPONSE_COMPLETE_FINAL flag must not be None.')
+        self._send(response, flags)
+        self._complete = final
+
+    def is_complete(self):
+        """Check whether the final response has been sent
+        Returns
+        -------
+        bool
+            True if the request is complete
+        """
+        return self._complete
+
 
 class InferenceResponse:
     """An InfrenceResponse object is used to represent the response to an
@@ -261,13 +370,39 @@ class Tensor:
             if triton_dtype is None:
                 triton_dtype = numpy_to_triton_type(numpy_array.dtype.type)
 
-        if not numpy_array.flags['C_CONTIGUOUS']:
-            numpy_array = np.ascontiguousarray(
-                numpy_array, dtype=numpy_array.dtype)
-
         self._triton_dtype = triton_dtype
         self._name = name
         self._numpy_array = numpy_array
+        self._dlpack_tensor = None
+
+    @classmethod
+    def from_dlpack(cls, name, dlpack_tensor):
+        """Create a Tensor from an object implementing the DLPack protocol,
+        e.g. a PyTorch tensor, or from a DLPack capsule. The data is not
+        copied. Objects implementing `__dlpack__` are copied to the shared
+        memory directly when the Tensor is an output, without creating a
+        numpy array.
+        Parameters
+        ----------
+        name : str
+            Tensor name
+        dlpack_tensor : object
+            An object implementing `__dlpack__`, or a DLPack capsule. The
+            tensor must be in the CPU memory.
+        Returns
+        -------
+        Tensor
+        """
+        if not hasattr(dlpack_tensor, '__dlpack__'):
+            # A capsule can only be consumed once.
+            return cls(name, _c_utils().from_dlpack(dlpack_tensor))
+
+        tensor = cls.__new__(cls)
+        tensor._name = name
+        tensor._triton_dtype = None
+        tensor._numpy_array = None
+        tensor._dlpack_tensor = dlpack_tensor
+        return tensor
 
     def name(self):
         """Get the name of tensor
@@ -281,6 +416,8 @@ class Tensor:
     def triton_dtype(self):
         """Get triton dtype for the tensor
         """
+        if self._triton_dtype is None:
+            self._triton_dtype = numpy_to_triton_type(self.as_numpy().dtype)
         return self._triton_dtype
 
     def as_numpy(self):
@@ -290,8 +427,42 @@ class Tensor:
         numpy.ndarray
             The numpy array
         """
+        if self._numpy_array is None:
+            self._numpy_array = _c_utils().from_dlpack(self._dlpack_tensor)
+            self._dlpack_tensor = None
         return self._numpy_array
 
+    def dlpack_tensor(self):
+        """Get the object this Tensor was created from with `from_dlpack`, or
+        None if the Tensor is backed by a numpy array.
+        """
+        return self._dlpack_tensor
+
+    def to_dlpack(self):
+        """Export the data of the Tensor as a DLPack capsule without copying
+        it. For example, an input can be used in PyTorch with
+        `torch.utils.dlpack.from_dlpack(tensor.to_dlpack())`.
+        Returns
+        -------
+        PyCapsule
+            A DLPack capsule that can be consumed once
+        """
+        if self._dlpack_tensor is not None:
+            return self._dlpack_tensor.__dlpack__()
+        if self._numpy_array.dtype == np.object_:
+            raise TritonModelException(
+                'Tensors of type BYTES cannot be exported through DLPack.')
+        return _c_utils().to_dlpack(self._numpy_array)
+
+    def __dlpack__(self, stream=None):
+        return self.to_dlpack()
+
+    def __dlpack_device__(self):
+        if self._dlpack_tensor is not None:
+            return self._dlpack_tensor.__dlpack_device__()
+        # (kDLCPU, 0)
+        return (1, 0)
+
 
 class RawData:
     """Representing a raw data object.
@@ -377,6 +548,157 @@ def get_input_tensor_by_name(inference_request, name):
     return None
 
 
+def get_batch_input_tensor_by_name(inference_requests, name):
+    """Find a Tensor shared by all the requests in the batch that has the
+    given name. This is either a ragged input of all the requests packed
+    into a single tensor, or a batch input generated by the backend.
+    Parameters
+    ----------
+    inference_requests : list
+        The list of InferenceRequest objects passed to `execute`
+    name : str
+        name of the ragged input or the target name of the batch input
+    Returns
+    -------
+    Tensor
+        The Tensor with the specified name, or None if no such
+        Tensor exists
+    """
+    if len(inference_requests) == 0:
+        return None
+
+    return inference_requests[0].batch_inputs().get(name)
+
+
+def batched_input(inference_requests, name):
+    """Get the input with the given name for all the requests as a single
+    numpy array. The backend places the input of consecutive requests back
+    to back in shared memory, so the returned array is a view and no data
+    is copied.
+    Parameters
+    ----------
+    inference_requests : list
+        The list of InferenceRequest objects passed to `execute`
+    name : str
+        name of the input
+    Returns
+    -------
+    (numpy.ndarray, list)
+        The input of all the requests, and a list of `len(inference_requests)
+        + 1` offsets along the first dimension of the array where the input
+        of each request starts and ends
+    Raises
+    ------
+    TritonModelException
+        If the input is missing in one of the requests, or if the inputs of
+        the requests have different data types or dimensions other than the
+        first one.
+    """
+    request_arrays = []
+    for inference_request in inference_requests:
+        input_tensor = get_input_tensor_by_name(inference_request, name)
+        if input_tensor is None:
+            raise TritonModelException(
+                'input "{}" is missing in one of the requests'.format(name))
+        request_arrays.append(input_tensor.as_numpy())
+
+    batch_tensor = get_batch_input_tensor_by_name(inference_requests, name)
+    if batch_tensor is not None:
+        batch_array = batch_tensor.as_numpy()
+    elif len(request_arrays) == 1:
+        batch_array = request_arrays[0]
+    else:
+        raise TritonModelException(
+            'input "{}" can not be batched because the requests have '
+            'different data types or dimensions'.format(name))
+
+    # Ragged inputs with different trailing dimensions are flattened.
+    if all(array.ndim == batch_array.ndim and array.ndim > 0
+           for array in request_arrays):
+        sizes = [array.shape[0] for array in request_arrays]
+    else:
+        sizes = [array.size for array in request_arrays]
+
+    offsets = [0]
+    for size in sizes:
+        offsets.append(offsets[-1] + size)
+
+    return batch_array, offsets
+
+
+def split_batch_output(inference_requests, source_input, output_array):
+    """Split an output computed for a packed ragged input back into one
+    array per request. The output is split along its first dimension,
+    proportionally to the number of elements of `source_input` in each
+    request. The returned arrays are views of `output_array`.
+    Parameters
+    ----------
+    inference_requests : list
+        The list of InferenceRequest objects passed to `execute`
+    source_input : str
+        name of the ragged input the output was computed from
+    output_array : numpy.ndarray
+        The output computed for the whole batch
+    Returns
+    -------
+    list
+        A list containing one numpy array for each request
+    """
+    element_counts = []
+    for inference_request in inference_requests:
+        input_tensor = get_input_tensor_by_name(inference_request,
+                                                source_input)
+        if input_tensor is None:
+            raise TritonModelException(
+                'input "{}" is missing in one of the requests'.format(
+                    source_input))
+        element_counts.append(input_tensor.as_numpy().size)
+
+    # Each request owns a number of rows of the output proportional to its
+    # number of input elements.
+    total_element_count = sum(element_counts)
+    output_rows = output_array.shape[0]
+
+    # A batch in which no request has any element has an empty output for
+    # every request.
+    if total_element_count == 0 and output_rows == 0:
+        return [output_array[0:0] for _ in element_counts]
+
+    offsets = [0]
+    for element_count in element_counts:
+        if total_element_count == 0 or \
+            (element_count * output_rows) % total_element_count != 0:
+            raise TritonModelException(
+                'output with first dimension {} can not be split according to '
+                'the element counts of input "{}"'.format(
+                    output_rows, source_input))
+        offsets.append(offsets[-1] +
+                       element_count * output_rows // total_element_count)
+
+    return [
+        output_array[offsets[i]:offsets[i + 1]]
+        for i in range(len(element_counts))
+    ]
+
+
+def using_decoupled_model_transaction_policy(model_config):
+    """Check whether the model uses the decoupled transaction policy
+    Parameters
+    ----------
+    model_config : dict
+        dictionary object containing the model configuration
+    Returns
+    -------
+    bool
+        True if the model is decoupled
+    """
+    if 'model_transaction_policy' in model_config:
+        return model_config['model_transaction_policy'].get(
+            'decoupled', False)
+
+    return False
+
+
 def get_input_config_by_name(model_config, name):
     """Get input properties corresponding to the input
     with given `name`
@@ -425,6 +747,44 @@ def get_output_config_by_name(model_config, name):
     return None
 
 
+def _iterate_async_generator(loop, async_generator):
+    """Iterate over the responses yielded by an `async` execute generator,
+    running it on the event loop of the stub.
+    """
+    while True:
+        try:
+            yield loop.run_until_complete(async_generator.__anext__())
+        except StopAsyncIteration:
+            return
+
+
+async def _complete_responses(awaitables, send_response):
+    """Await the responses of the requests concurrently, and call
+    `send_response(index, response)` as soon as each one is ready. A request
+    whose awaitable raises an exception gets an error response.
+    """
+
+    async def complete(index, awaitable):
+        try:
+            response = await awaitable
+        except Exception as e:
+            response = InferenceResponse([], error=TritonError(str(e)))
+        send_response(index, response)
+
+    await asyncio.gather(
+        *(complete(index, awaitable)
+          for index, awaitable in enumerate(awaitables)))
+
+
+def _c_utils():
+    """The module implemented by the stub process, e.g. for the DLPack
+    interchange. It is imported lazily so that this file can also be imported
+    outside of the stub.
+    """
+    import c_python_backend_utils
+    return c_python_backend_utils
+
+
 def triton_to_numpy_type(data_type):
     if data_type == 1:
         return np.bool_
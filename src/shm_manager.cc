@@ -41,6 +41,7 @@ namespace bi = boost::interprocess;
 SharedMemory::SharedMemory(
     const std::string& shm_key, int64_t default_byte_size,
     int64_t shm_growth_bytes, bool truncate)
+    : owner_(truncate)
 {
   if (truncate) {
     shm_obj_ = bi::shared_memory_object(
@@ -85,33 +86,40 @@ SharedMemory::SharedMemory(
 
 SharedMemory::~SharedMemory() noexcept(false)
 {
-  bi::shared_memory_object::remove(shm_key_.c_str());
+  if (owner_) {
+    bi::shared_memory_object::remove(shm_key_.c_str());
+  }
 }
 
 void
 SharedMemory::Map(char** shm_addr, size_t byte_size, off_t& offset)
 {
-  size_t shm_bytes_added = 0;
-  while (*offset_ + byte_size >= *capacity_) {
+  size_t capacity = *capacity_;
+  while (*offset_ + byte_size >= capacity) {
     // Increase the shared memory pool size by the amount of bytes available.
-    *capacity_ += shm_growth_bytes_;
-    shm_bytes_added += shm_growth_bytes_;
+    capacity += shm_growth_bytes_;
   }
 
-  if (shm_bytes_added > 0) {
+  if (capacity != *capacity_) {
     try {
-      shm_obj_.truncate(*capacity_);
+      shm_obj_.truncate(capacity);
     }
     catch (bi::interprocess_exception& ex) {
-      *capacity_ -= shm_bytes_added;
       std::string error_message =
           ("Failed to increase the shared memory pool size for key '" +
-           shm_key_ + "' to " + std::to_string(*capacity_) +
+           shm_key_ + "' to " + std::to_string(capacity) +
            " bytes. If you are running Triton inside docker, use '--shm-size' "
            "flag to control the shared memory region size. Error: " +
            ex.what());
       throw PythonBackendException(error_message);
     }
+
+    // The other process may read the pool while this one allocates from it,
+    // e.g. the parent sends the completed responses while the stub creates
+    // the other ones. The new capacity is only published once the shared
+    // memory object has grown, so that the other process never maps a region
+    // smaller than the capacity.
+    __atomic_store_n(capacity_, capacity, __ATOMIC_RELEASE);
   }
 
   UpdateSharedMemory();
@@ -125,7 +133,8 @@ SharedMemory::Map(char** shm_addr, size_t byte_size, off_t& offset)
 void
 SharedMemory::UpdateSharedMemory()
 {
-  if (current_capacity_ != *capacity_) {
+  const size_t capacity = __atomic_load_n(capacity_, __ATOMIC_ACQUIRE);
+  if (current_capacity_ != capacity) {
     std::unique_ptr<bi::mapped_region> new_map;
     try {
       new_map = std::make_unique<bi::mapped_region>(shm_obj_, bi::read_write);
@@ -139,7 +148,7 @@ SharedMemory::UpdateSharedMemory()
     }
 
     old_shm_maps_.emplace_back(std::move(shm_map_));
-    current_capacity_ = *capacity_;
+    current_capacity_ = capacity;
     shm_map_ = std::move(new_map);
     shm_addr_ = (char*)shm_map_->get_address();
   }
@@ -39,6 +39,11 @@ namespace triton { namespace backend { namespace python {
 
 class SharedMemory {
   std::string shm_key_;
+
+  // Whether this process has created the shared memory object, and removes
+  // it when done. The stub of a shared stub process can be replaced while
+  // the process keeps running, so only the parent process removes it.
+  bool owner_;
   size_t* capacity_;
   off_t* offset_;
   char* shm_addr_;
@@ -65,6 +70,9 @@ class SharedMemory {
   void MapOffset(char** shm_addr, size_t byte_size, off_t offset);
   void Map(char** shm_addr, size_t byte_size, off_t& offset);
   void SetOffset(off_t offset);
+
+  // Offset of the next allocation
+  off_t Offset() { return *offset_; }
   ~SharedMemory() noexcept(false);
 };
 